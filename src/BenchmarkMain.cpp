@@ -0,0 +1,266 @@
+// Copyright 2012: Eugen Sawin, Philip Stahl, Jonas Sternisko
+/**
+ * Measures Dijkstra searches on a GTFS network: the search variants compiled
+ * for each use case against the general variant, queries directed by
+ * landmarks against undirected ones, and full searches as run by
+ * the transfer pattern precomputation before and after renumbering and
+ * reducing the nodes and, optionally, with the walking transfers added as arcs.
+ * Reports time and, where the kernel permits, hardware cache misses.
+ */
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <boost/program_options.hpp>
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "./Clock.h"
+#include "./Dijkstra.h"
+#include "./GtfsParser.h"
+#include "./HubSet.h"
+#include "./Landmarks.h"
+#include "./Random.h"
+#include "./TransferPatternRouter.h"
+#include "./TransitNetwork.h"
+#include "./Utilities.h"
+
+namespace po = boost::program_options;
+using std::string;
+using std::vector;
+using std::cout;
+using std::endl;
+using base::Clock;
+
+const int kNumSearchesDef = 20;
+const int kSeedDef = 1;
+const int kWalkTimeDef = 0;
+
+// Counts the hardware cache misses of the calling thread. Counts nothing if
+// perf events are not available.
+class CacheMissCounter {
+ public:
+  CacheMissCounter() {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    _fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+  }
+
+  ~CacheMissCounter() {
+    if (_fd != -1)
+      close(_fd);
+  }
+
+  bool available() const { return _fd != -1; }
+
+  void start() {
+    if (_fd == -1)
+      return;
+    ioctl(_fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(_fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+
+  int64_t stop() {
+    if (_fd == -1)
+      return 0;
+    ioctl(_fd, PERF_EVENT_IOC_DISABLE, 0);
+    int64_t count = 0;
+    if (read(_fd, &count, sizeof(count)) != sizeof(count))
+      return 0;
+    return count;
+  }
+
+ private:
+  int _fd;
+};
+
+// Runs a full search from each of the stops and prints the totals.
+void benchmark(const string& title, const TransitNetwork& network,
+               const vector<int>& stops) {
+  CacheMissCounter counter;
+  Dijkstra dijkstra(network);
+  size_t numSettled = 0;
+  Clock::Diff duration = 0;
+  int64_t misses = 0;
+  for (auto stop = stops.begin(); stop != stops.end(); ++stop) {
+    const vector<int> depNodes = network.getDepNodes(*stop);
+    QueryResult result;
+    Clock start;
+    counter.start();
+    dijkstra.findShortestPath(depNodes, INT_MAX, &result);
+    misses += counter.stop();
+    duration += Clock() - start;
+    numSettled += result.numSettledLabels;
+  }
+  cout << title << ": " << stops.size() << " searches, " << numSettled
+       << " settled labels, " << Clock::DiffStr(duration);
+  if (counter.available())
+    cout << ", " << misses << " cache misses";
+  else
+    cout << ", cache misses not available";
+  cout << endl;
+}
+
+// Runs the searches from the given nodes to the given stops in the general
+// and in the specialized variant and prints the totals.
+void benchmarkVariants(const string& title, Dijkstra* dijkstra,
+                       const vector<vector<int> >& depNodes,
+                       const vector<int>& destStops) {
+  for (int specialize = 0; specialize < 2; ++specialize) {
+    dijkstra->specialize(specialize);
+    size_t numSettled = 0;
+    Clock start;
+    for (size_t i = 0; i < depNodes.size(); ++i) {
+      QueryResult result;
+      dijkstra->findShortestPath(depNodes[i], destStops[i], &result);
+      numSettled += result.numSettledLabels;
+    }
+    cout << title << (specialize ? ", specialized: " : ", general: ")
+         << depNodes.size() << " searches, " << numSettled
+         << " settled labels, " << Clock::DiffStr(Clock() - start) << endl;
+  }
+}
+
+// Compares the search variants for the hub selection on the time-compressed
+// network, point-to-point queries and full searches with hubs.
+void benchmarkVariants(const TransitNetwork& network, const vector<int>& stops,
+                       const int time) {
+  const TransitNetwork compressed = network.createTimeCompressedNetwork();
+  vector<vector<int> > depNodes;
+  for (auto stop = stops.begin(); stop != stops.end(); ++stop)
+    depNodes.push_back(vector<int>(1, *stop));
+  Dijkstra compressedSearch(compressed);
+  benchmarkVariants("compressed", &compressedSearch, depNodes,
+                    vector<int>(stops.size(), INT_MAX));
+
+  depNodes.clear();
+  vector<int> destStops;
+  for (size_t i = 0; i < stops.size(); ++i) {
+    depNodes.push_back(network.findStartNodeSequence(network.stop(stops[i]),
+                                                     time));
+    destStops.push_back(stops[(i + 1) % stops.size()]);
+  }
+  Dijkstra query(network);
+  query.startTime(time);
+  benchmarkVariants("query", &query, depNodes, destStops);
+  Landmarks landmarks;
+  Clock start;
+  landmarks.init(compressed, TransferPatternRouter::NUM_LANDMARKS,
+                 TransitNetwork::TRANSFER_BUFFER);
+  cout << "selected " << landmarks.size() << " landmarks in "
+       << Clock::DiffStr(Clock() - start) << endl;
+  query.landmarks(&landmarks);
+  benchmarkVariants("query, landmarks", &query, depNodes, destStops);
+
+  // The stops with the most nodes as hubs, like the basic hub selection.
+  vector<std::pair<int, int> > sizes;
+  for (size_t i = 0; i < network.numStops(); ++i)
+    sizes.push_back(std::make_pair(-network.stop(i).numNodes(), i));
+  std::sort(sizes.begin(), sizes.end());
+  HubSet hubs;
+  for (size_t i = 0; i < sizes.size() / 100 + 1; ++i)
+    hubs.insert(sizes[i].second);
+  depNodes.clear();
+  for (auto stop = stops.begin(); stop != stops.end(); ++stop)
+    depNodes.push_back(network.getDepNodes(*stop));
+  Dijkstra full(network);
+  full.hubs(&hubs);
+  full.maxHubPenalty(0);
+  benchmarkVariants("hubs", &full, depNodes,
+                    vector<int>(stops.size(), INT_MAX));
+}
+
+bool parseArgs(int argc, char* argv[], string& gtfsDirs, string& startTime,
+               string& endTime, int& numSearches, int& seed, int& walkTime);
+
+int main(int argc, char* argv[]) {
+  string gtfsDirs;
+  string startTime = time2str(firstOfMay());
+  string endTime = time2str(firstOfMay() + kSecondsPerDay - 1);
+  int numSearches = kNumSearchesDef;
+  int seed = kSeedDef;
+  int walkTime = kWalkTimeDef;
+  if (!parseArgs(argc, argv, gtfsDirs, startTime, endTime, numSearches,
+                 seed, walkTime)) {
+    return 1;
+  }
+  vector<string> dirs = splitString(gtfsDirs);
+  for (auto it = dirs.begin(); it != dirs.end(); ++it) { it->append("/"); }
+  GtfsParser parser;
+  TransitNetwork network = parser.createTransitNetwork(dirs, startTime,
+                                                       endTime);
+  network.preprocess();
+  cout << network.numStops() << " stops, " << network.numNodes()
+       << " nodes, " << network.numArcs() << " arcs" << endl;
+  if (network.numStops() == 0)
+    return 1;
+
+  RandomGen random(0, network.numStops() - 1, seed);
+  vector<int> stops;
+  for (int i = 0; i < numSearches; ++i)
+    stops.push_back(random.next());
+
+  benchmarkVariants(network, stops, str2time(startTime) + 8 * 60 * 60);
+
+  benchmark("parser order", network, stops);
+  Clock start;
+  network.renumberNodes();
+  cout << "renumbered the nodes in " << Clock::DiffStr(Clock() - start)
+       << endl;
+  benchmark("renumbered", network, stops);
+  const size_t numNodes = network.numNodes();
+  const size_t numArcs = network.numArcs();
+  start = Clock();
+  network.reduce();
+  cout << "reduced the network in " << Clock::DiffStr(Clock() - start)
+       << " by " << numNodes - network.numNodes() << " nodes and "
+       << numArcs - network.numArcs() << " arcs to " << network.numNodes()
+       << " nodes, " << network.numArcs() << " arcs" << endl;
+  benchmark("reduced", network, stops);
+  if (walkTime > 0) {
+    start = Clock();
+    network.addWalkArcs(walkTime);
+    cout << "added walk arcs in " << Clock::DiffStr(Clock() - start) << ", "
+         << network.numArcs() << " arcs" << endl;
+    benchmark("walk arcs", network, stops);
+  }
+  return 0;
+}
+
+bool parseArgs(int argc, char* argv[], string& gtfsDirs, string& startTime,
+               string& endTime, int& numSearches, int& seed, int& walkTime) {
+  po::options_description args("Benchmark options");
+  args.add_options()
+      ("help,h", "show help")
+      ("gtfs,g", po::value<string>(&gtfsDirs), "GTFS data directories")
+      ("start,s", po::value<string>(&startTime)->default_value(startTime),
+       "start of the time period")
+      ("end,e", po::value<string>(&endTime)->default_value(endTime),
+       "end of the time period")
+      ("searches,n",
+       po::value<int>(&numSearches)->default_value(kNumSearchesDef),
+       "number of full searches")
+      ("seed,r", po::value<int>(&seed)->default_value(kSeedDef),
+       "seed of the random start stops")
+      ("walk,w", po::value<int>(&walkTime)->default_value(kWalkTimeDef),
+       "add walk arcs up to this walking time in seconds");
+  po::variables_map vm;
+  po::store(po::parse_command_line(argc, argv, args), vm);
+  po::notify(vm);
+
+  if (vm.count("help") || gtfsDirs.empty()) {
+    cout << args << endl;
+    return false;
+  }
+  return true;
+}
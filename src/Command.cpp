@@ -113,9 +113,11 @@ vector<Query> Command::getRandQueries(int numQueries, int numStops, int seed) {
 
 void Command::dijkstraQuery(const TransitNetwork& network, const HubSet* hubs,
                            const int dep, const int time, const int dest,
-                           QueryResult* resultPtr) {
+                           QueryResult* resultPtr,
+                           const Landmarks* landmarks) {
   Dijkstra dijkstra(network);
   dijkstra.hubs(hubs);
+  dijkstra.landmarks(landmarks);
   dijkstra.maxPenalty(3);
   dijkstra.maxHubPenalty(3);
   const Stop& depStop = network.stop(dep);
@@ -338,10 +340,14 @@ vector<string> FindRoute::operator()(Server& server,  // NOLINT
   }
   if (!useTransferPatterns) {
     QueryResult result;
-    const TransitNetwork& network = server.scenarioSet() ? server.scenario()
-                                                         : server.network();
+    const TransitNetwork& network =
+        server.scenarioSet() ? server.scenario() : server.queryNetwork();
     const HubSet* hubs = &server.router().hubs();
-    dijkstraQuery(network, hubs, dep, str2time(depTime), dest, &result);
+    // The landmarks are computed on the original network.
+    const Landmarks* landmarks = &network == &server.network()
+                                 ? &server.router().landmarks() : NULL;
+    dijkstraQuery(network, hubs, dep, str2time(depTime), dest, &result,
+                  landmarks);
     ostringstream path;
 
     // debug
@@ -483,18 +489,25 @@ vector<string> Test::operator()(Server& server,  // NOLINT
   // Compare Results
   progress = 0;
   int numPathsDi, numReachedDi, numPathsTp, numReachedTp, numInvalid, numSubset,
-      numAlmostSubset, numFailed, numTpInvalid;
+      numAlmostSubset, numFailed, numTpInvalid, numAltDiffer;
   numPathsDi = numReachedDi = numPathsTp = numReachedTp = numInvalid =
-      numSubset = numAlmostSubset = numFailed = numTpInvalid = 0;
+      numSubset = numAlmostSubset = numFailed = numTpInvalid = numAltDiffer = 0;
+  // The settled labels of the Dijkstra and of the goal-directed (ALT) search.
+  int64_t numSettledDi = 0;
+  int64_t numSettledAlt = 0;
+  const Landmarks* landmarks = server.scenarioSet() ? NULL
+                               : &server.router().landmarks();
   const int nThreads = server.maxWorkers() > omp_get_max_threads() ?
                        omp_get_max_threads() : server.maxWorkers();
   omp_set_num_threads(nThreads);
   #pragma omp parallel reduction(+:numPathsDi, numReachedDi, numPathsTp, \
                                   numReachedTp, numInvalid, numSubset, \
-                                  numAlmostSubset, numFailed, numTpInvalid)
+                                  numAlmostSubset, numFailed, numTpInvalid, \
+                                  numAltDiffer, numSettledDi, numSettledAlt)
   {  // NOLINT
   numPathsDi = numReachedDi = numPathsTp = numReachedTp = numInvalid =
-      numSubset = numAlmostSubset = numFailed = numTpInvalid = 0;
+      numSubset = numAlmostSubset = numFailed = numTpInvalid = numAltDiffer = 0;
+  numSettledDi = numSettledAlt = 0;
   Logger logger;
   const HubSet& hubs = server.router().hubs();
   #pragma omp for
@@ -505,6 +518,21 @@ vector<string> Test::operator()(Server& server,  // NOLINT
     Command::dijkstraQuery(network, &hubs, query.dep, str2time(query.time),
                            query.dest, &dijkstraResult);
     const double secondsDijkstra = logger.endPerf(perfId);
+    numSettledDi += dijkstraResult.numSettledLabels;
+    if (landmarks) {
+      QueryResult altResult;
+      Command::dijkstraQuery(network, &hubs, query.dep, str2time(query.time),
+                             query.dest, &altResult, landmarks);
+      numSettledAlt += altResult.numSettledLabels;
+      set<pair<int, int> > costs, altCosts;
+      for (auto it = dijkstraResult.destLabels.begin();
+           it != dijkstraResult.destLabels.end(); ++it)
+        costs.insert(make_pair((*it).cost(), (*it).penalty()));
+      for (auto it = altResult.destLabels.begin();
+           it != altResult.destLabels.end(); ++it)
+        altCosts.insert(make_pair((*it).cost(), (*it).penalty()));
+      numAltDiffer += costs != altCosts;
+    }
 
     numPathsDi += dijkstraResult.destLabels.size();
     numReachedDi += !!dijkstraResult.destLabels.size();
@@ -584,6 +612,13 @@ vector<string> Test::operator()(Server& server,  // NOLINT
           << "Almost OK: " << _numAlmostSubset << "; "
           << "Failed: " << _numFailed << "; "
           << "Long path without hub: " << _numTpInvalid << ";";
+  if (landmarks) {
+    logText << " ALT: " << numSettledAlt << " of " << numSettledDi
+            << " settled labels ("
+            << (numSettledDi ? 100 * numSettledAlt / numSettledDi : 0)
+            << "%), " << landmarks->size() << " landmarks, "
+            << numAltDiffer << " different;";
+  }
   serverLog.info(logText.str());
   Logger overview;
   overview.target("log/experiments/" + network.name() + "_" +
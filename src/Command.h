@@ -38,10 +38,12 @@ class Command {
   // to numStops, times from 0:00:00 to 23:59:00 at 1st of may 2012.
   static vector<Query> getRandQueries(int numQueries, int numStops, int seed);
 
-  // Computes the shortest path between dep and dest stop @ time
+  // Computes the shortest path between dep and dest stop @ time, directed
+  // towards dest by the landmarks if given.
   static void dijkstraQuery(const TransitNetwork& network, const HubSet* hubs,
                            const int dep, const int time, const int dest,
-                           QueryResult* resultPtr);
+                           QueryResult* resultPtr,
+                           const Landmarks* landmarks = NULL);
 };
 
 class WebCommand : public Command {
@@ -3,57 +3,237 @@
 // Author: Hannah Bast <bast>.
 
 #include <assert.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include <algorithm>
 #include <string>
+#include <utility>
 #include <vector>
 #include "./CsvParser.h"
 
-using std::cout;
-using std::endl;
 using std::vector;
 using std::string;
-using std::remove;
+using std::make_pair;
+
+namespace {
+// Returns the first ',', '"', '\r' or '\n' in [pos, end) or end if there is
+// none. Tests 16 bytes at once where SSE2 is available.
+inline const char* findSpecial(const char* pos, const char* end) {
+#ifdef __SSE2__
+  const __m128i comma = _mm_set1_epi8(',');
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i cr = _mm_set1_epi8('\r');
+  const __m128i lf = _mm_set1_epi8('\n');
+  for (; pos + 16 <= end; pos += 16) {
+    const __m128i block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+    const __m128i hits =
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, comma),
+                                  _mm_cmpeq_epi8(block, quote)),
+                     _mm_or_si128(_mm_cmpeq_epi8(block, cr),
+                                  _mm_cmpeq_epi8(block, lf)));
+    const int mask = _mm_movemask_epi8(hits);
+    if (mask) {
+      return pos + __builtin_ctz(mask);
+    }
+  }
+#endif
+  for (; pos < end; ++pos) {
+    const char c = *pos;
+    if (c == ',' || c == '"' || c == '\r' || c == '\n') {
+      return pos;
+    }
+  }
+  return end;
+}
+}  // namespace
+
+// ____________________________________________________________________________
+CsvParser::CsvParser()
+    : _map(NULL), _mapSize(0), _open(false), _pos(NULL), _end(NULL),
+      _eof(false) {}
+
+// ____________________________________________________________________________
+CsvParser::~CsvParser() {
+  if (_open) {
+    closeFile();
+  }
+}
 
 // ____________________________________________________________________________
 void CsvParser::openFile(string fileName) {
-  _fileStream.open(fileName.c_str());
-  assert(_fileStream.good());
+  assert(!_open);
+  const int fd = open(fileName.c_str(), O_RDONLY);
+  assert(fd != -1 && "CsvParser: unable to open file");
+  struct stat info;
+  fstat(fd, &info);
+  _mapSize = info.st_size;
+  if (_mapSize > 0) {
+    void* map = mmap(NULL, _mapSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    assert(map != MAP_FAILED);
+    madvise(map, _mapSize, MADV_SEQUENTIAL);
+    _map = static_cast<char*>(map);
+  }
+  close(fd);
+  _open = true;
+  _pos = _map;
+  _end = _map + _mapSize;
+  _eof = false;
   readNextLine();
-  assert(_currentItems.size() > 0);
+  assert(_fields.size() > 0);
 }
 
 
 // ____________________________________________________________________________
 void CsvParser::readNextLine() {
-  assert(_fileStream.good());
-  getline(_fileStream, _currentLine);
-  // remove new line characters
-  _currentLine.erase(remove(_currentLine.begin(), _currentLine.end(), '\r'),
-                     _currentLine.end());
-  _currentLine.erase(remove(_currentLine.begin(), _currentLine.end(), '\n'),
-                     _currentLine.end());
-  size_t pos = 0;
-  _currentItems.clear();
-  if (_fileStream.eof() && _currentLine.empty()) return;
-  // size_t i = 0;
-  while (pos != string::npos) {
-    size_t lastPos = pos;
-    pos = _currentLine.find(',', pos);
-    if (pos != string::npos) _currentLine[pos++] = 0;
-    _currentItems.push_back(_currentLine.c_str() + lastPos);
-    // assert(i < _currentItems.size());
-    // _currentItems[i++] = _currentLine.c_str() + lastPos;
+  assert(_open && !_eof);
+  _fields.clear();
+  _unescaped.clear();
+  _unescapedFields.clear();
+  if (_pos >= _end) {
+    _eof = true;
+    return;
+  }
+  const char* fieldStart = _pos;
+  const char* pos = _pos;
+  // Whether the current field was quoted and is already stored.
+  bool quoted = false;
+  while (true) {
+    pos = findSpecial(pos, _end);
+    if (pos < _end && *pos == '"') {
+      if (pos == fieldStart) {
+        pos = readQuotedField(pos);
+        quoted = true;
+      } else {
+        // A quote inside an unquoted field is taken literally.
+        ++pos;
+      }
+      continue;
+    }
+    if (!quoted) {
+      _fields.push_back(CsvField(fieldStart, pos - fieldStart));
+    }
+    quoted = false;
+    if (pos == _end) {
+      // Last line without line break.
+      _eof = true;
+      break;
+    }
+    if (*pos == ',') {
+      fieldStart = ++pos;
+      continue;
+    }
+    // End of the record: skip "\n", "\r\n" or "\r".
+    if (*pos == '\r' && pos + 1 < _end && pos[1] == '\n') {
+      ++pos;
+    }
+    ++pos;
+    break;
+  }
+  _pos = pos;
+  for (size_t i = 0; i < _unescapedFields.size(); ++i) {
+    CsvField& field = _fields[_unescapedFields[i].first];
+    field = CsvField(_unescaped.data() + _unescapedFields[i].second,
+                     field.size());
+  }
+}
+
+// ____________________________________________________________________________
+const char* CsvParser::readQuotedField(const char* pos) {
+  assert(*pos == '"');
+  const char* begin = ++pos;
+  while (true) {
+    const char* quote = static_cast<const char*>(
+        memchr(pos, '"', _end - pos));
+    if (!quote) {
+      // Unterminated quote: take the rest of the file.
+      quote = _end;
+    }
+    if (quote + 1 < _end && quote[1] == '"') {
+      // Escaped quote, continue after it.
+      pos = quote + 2;
+      continue;
+    }
+    // Closing quote found. Unescape the contents if there are quote pairs.
+    const char* pair = static_cast<const char*>(
+        memchr(begin, '"', quote - begin));
+    if (!pair) {
+      _fields.push_back(CsvField(begin, quote - begin));
+    } else {
+      const size_t offset = _unescaped.size();
+      for (const char* c = begin; c < quote; ++c) {
+        _unescaped.push_back(*c);
+        if (*c == '"') {
+          ++c;
+        }
+      }
+      _unescapedFields.push_back(make_pair(_fields.size(), offset));
+      _fields.push_back(CsvField(NULL, _unescaped.size() - offset));
+    }
+    return std::min(quote + 1, _end);
   }
 }
 
+// ____________________________________________________________________________
+const CsvField& CsvParser::field(size_t i) const {
+  assert(i < _fields.size());
+  return _fields[i];
+}
+
 // ____________________________________________________________________________
 const char* CsvParser::getItem(size_t i) {
-  assert(i < _currentItems.size());
-  return _currentItems[i];
+  assert(i < _fields.size());
+  if (_items.size() <= i) {
+    _items.resize(i + 1);
+  }
+  _items[i].assign(_fields[i].data(), _fields[i].size());
+  return _items[i].c_str();
+}
+
+// ____________________________________________________________________________
+void CsvParser::seek(size_t offset) {
+  assert(_open && offset <= _mapSize);
+  _pos = _map + offset;
+  _eof = false;
+  _fields.clear();
+}
+
+// ____________________________________________________________________________
+size_t CsvParser::lineStart(size_t offset) const {
+  assert(_open && offset <= _mapSize);
+  if (offset == 0 || offset == _mapSize || _map[offset - 1] == '\n') {
+    return offset;
+  }
+  const char* lineBreak = static_cast<const char*>(
+      memchr(_map + offset, '\n', _mapSize - offset));
+  return lineBreak ? lineBreak + 1 - _map : _mapSize;
+}
+
+// ____________________________________________________________________________
+size_t CsvParser::previousLineStart(size_t offset) const {
+  assert(_open && offset > 0 && offset <= _mapSize);
+  // Skip the line break ending the previous line.
+  size_t pos = offset - 1;
+  while (pos > 0 && _map[pos - 1] != '\n') {
+    --pos;
+  }
+  return pos;
 }
 
 // ____________________________________________________________________________
 void CsvParser::closeFile() {
-  assert(_fileStream.is_open());
-  _fileStream.close();
+  assert(_open);
+  if (_map) {
+    munmap(_map, _mapSize);
+  }
+  _map = NULL;
+  _mapSize = 0;
+  _pos = _end = NULL;
+  _fields.clear();
+  _open = false;
 }
@@ -6,27 +6,68 @@
 #define SRC_CSVPARSER_H_
 
 #include <gtest/gtest.h>
-#include <fstream>
+#include <cstring>
 #include <string>
 #include <vector>
 
 using std::string;
 using std::vector;
 
-// Class for processing the CSV files from GTFS.
+// A field of the current CSV record. It refers to the memory mapped file or,
+// for quoted fields with escaped quotes, to the parser's unescape buffer and
+// is valid until the next call to CsvParser::readNextLine.
+class CsvField {
+ public:
+  CsvField() : _data(""), _size(0) {}
+  CsvField(const char* data, const size_t size) : _data(data), _size(size) {}
+
+  const char* data() const { return _data; }
+  size_t size() const { return _size; }
+  bool empty() const { return _size == 0; }
+  char operator[](const size_t i) const { return _data[i]; }
+
+  // Returns a copy of the field as string.
+  string str() const { return string(_data, _size); }
+
+  bool operator==(const CsvField& other) const {
+    return _size == other._size && memcmp(_data, other._data, _size) == 0;
+  }
+  bool operator==(const string& other) const {
+    return _size == other.size() && memcmp(_data, other.data(), _size) == 0;
+  }
+  bool operator!=(const string& other) const { return !(*this == other); }
+
+ private:
+  const char* _data;
+  size_t _size;
+};
+
+// Class for processing the CSV files from GTFS. The file is memory mapped and
+// each record is tokenized in place following RFC 4180: fields may be quoted,
+// quoted fields may contain commas, line breaks and escaped quotes ("").
 class CsvParser {
  public:
+  CsvParser();
+  ~CsvParser();
+
   // Opens file and reads first line with table headers.
   void openFile(string fileName);
 
-  // Returns true iff same function of underlying stream returns true.
-  bool eof() const { return _fileStream.eof(); }
+  // Returns true iff the last call to readNextLine reached the end of the
+  // file, like the eof flag of an input stream after getline.
+  bool eof() const { return _eof; }
 
   // Read next line.
   void readNextLine();
   FRIEND_TEST(CsvParserTest, readNextLine);
 
-  // Get i-th column from current line. Prerequisite: i < _numColumns.
+  // Returns the i-th field of the current line without copying it.
+  // Prerequisite: i < getNumColumns().
+  const CsvField& field(size_t i) const;
+
+  // Get i-th column from current line as null-terminated string. The pointer
+  // is valid until the next call to readNextLine.
+  // Prerequisite: i < getNumColumns().
   const char* getItem(size_t i);
 
   // Close file. Prerequisite: file must have been opened with openFile before,
@@ -34,17 +75,51 @@ class CsvParser {
   void closeFile();
 
   // Get the number of columns. Will be zero before openFile has been called.
-  size_t getNumColumns() const { return _currentItems.size(); }
+  size_t getNumColumns() const { return _fields.size(); }
+
+  // Returns the size of the opened file in bytes.
+  size_t fileSize() const { return _mapSize; }
+
+  // Returns the byte offset of the next line to be read.
+  size_t offset() const { return _pos - _map; }
+
+  // Continues reading with the line starting at the given byte offset.
+  void seek(size_t offset);
+
+  // Returns the offset of the first line starting at or after the given
+  // offset. Assumes that the following line break is not quoted, which holds
+  // for the GTFS files we split (see GtfsParser::parseStopTimesFile).
+  size_t lineStart(size_t offset) const;
+
+  // Returns the offset of the line preceding the line starting at offset.
+  // Prerequisite: offset > 0 is the start of a line.
+  size_t previousLineStart(size_t offset) const;
 
  private:
-  // The handle to the file.
-  std::ifstream _fileStream;
+  // Reads the quoted field starting at the opening quote pos. Returns the
+  // position after the closing quote.
+  const char* readQuotedField(const char* pos);
+
+  // The mapped file and its size.
+  char* _map;
+  size_t _mapSize;
+  bool _open;
+
+  // The unread part of the file.
+  const char* _pos;
+  const char* _end;
+  bool _eof;
+
+  // The fields of the current line.
+  vector<CsvField> _fields;
 
-  // Current line (pointers returned by readNextLine will refer to parts of it.
-  string _currentLine;
+  // Unescaped contents of quoted fields with escaped quotes. Fields referring
+  // to it are listed in _unescapedFields with their offset in the buffer.
+  string _unescaped;
+  vector<std::pair<size_t, size_t> > _unescapedFields;
 
-  // Pointers to the items in the current line.
-  vector<const char*> _currentItems;
+  // Null-terminated copies of the fields requested via getItem.
+  vector<string> _items;
 };
 
 #endif  // SRC_CSVPARSER_H_
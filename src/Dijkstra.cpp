@@ -1,6 +1,7 @@
 // Copyright 2011: Eugen Sawin, Philip Stahl, Jonas Sternisko
 #include "./Dijkstra.h"
 #include <cassert>
+#include <climits>
 #include <cmath>
 #include <vector>
 #include <string>
@@ -12,6 +13,7 @@
 #include <set>
 #include <map>
 #include "./DirectConnection.h"
+#include "./Landmarks.h"
 #include "./TransitNetwork.h"
 #include "./Utilities.h"
 
@@ -33,6 +35,7 @@ QueryResult::QueryResult() {
 
 void QueryResult::clear() {
   numSettledLabels = 0;
+  lowerBounds.clear();
 }
 
 int QueryResult::optimalCosts() const {
@@ -185,8 +188,10 @@ QueryResult::optimalPaths(const QueryGraph& graph, string* log) const {
 // Dijkstra
 
 Dijkstra::Dijkstra(const TransitNetwork& network)
-  : _network(network), _log(&LOG), _hubs(NULL),
-    _maxPenalty(3), _maxHubPenalty(3), _maxCost(INT_MAX), _startTime(0) {}
+  : _network(network), _log(&LOG), _hubs(NULL), _landmarks(NULL),
+    _maxPenalty(3), _maxHubPenalty(3),
+    _maxCost(network.period() ? network.period() - 1 : INT_MAX), _startTime(0),
+    _specialize(true) {}
 
 
 void Dijkstra::logger(const Logger* log) {
@@ -198,6 +203,36 @@ void Dijkstra::logger(const Logger* log) {
 void Dijkstra::findShortestPath(const vector<int>& depNodes,
                                 const int destStop,
                                 QueryResult* resultPtr) const {
+  typedef void (Dijkstra::*Search)(const vector<int>&, const int,
+                                   QueryResult*) const;
+  static const Search searches[] = {
+    &Dijkstra::search<false, false, false>,
+    &Dijkstra::search<false, false, true>,
+    &Dijkstra::search<false, true, false>,
+    &Dijkstra::search<false, true, true>,
+    &Dijkstra::search<true, false, false>,
+    &Dijkstra::search<true, false, true>,
+    &Dijkstra::search<true, true, false>,
+    &Dijkstra::search<true, true, true>
+  };
+  // The general variant checks all settings at run time.
+  int variant = 7;
+  if (_specialize) {
+    const bool target = destStop != INT_MAX;
+    const bool hubs = _hubs && !_hubs->empty();
+    const vector<vector<Arc> >& walkways = _network.walkingGraph();
+    bool walk = false;
+    for (auto it = walkways.begin(); !walk && it != walkways.end(); ++it)
+      walk = !it->empty();
+    variant = 4 * target + 2 * hubs + walk;
+  }
+  (this->*searches[variant])(depNodes, destStop, resultPtr);
+}
+
+
+template<bool kTarget, bool kHubs, bool kWalk>
+void Dijkstra::search(const vector<int>& depNodes, const int destStop,
+                      QueryResult* resultPtr) const {
   QueryResult& result = *resultPtr;
   result.clear();
   result.destLabels = LabelVec(destStop, _maxPenalty + _maxHubPenalty);
@@ -205,6 +240,13 @@ void Dijkstra::findShortestPath(const vector<int>& depNodes,
   if (depNodes.empty()) {
     return;
   }
+  // Goal-directed searches order the labels by cost plus lower bound.
+  if (kTarget && destStop != INT_MAX && _landmarks)
+    result.lowerBounds.assign(_network.numStops(), UINT_MAX);
+  // Walk arcs in the network replace the walking on arrival.
+  const bool walkArcs = _network.maxWalkTime() > 0;
+  // The days of periodic networks follow from the start time.
+  assert(!_network.period() || _startTime);
   PriorityQueue queue;
   // init the queue with departure nodes
   int numOpened = 0;
@@ -214,24 +256,27 @@ void Dijkstra::findShortestPath(const vector<int>& depNodes,
     assert(result.matrix.candidate(node, 0, 0));
     LabelMatrix::Hnd label;
     if (_startTime) {
-      int waitTime = _network.node(node).time() - _startTime;
+      int waitTime = _network.waitTime(_startTime, node);
       assert(waitTime >= 0);
+      if (!boards(node, waitTime))
+        continue;
       label = result.matrix.add(node, waitTime, 0, _maxPenalty);
     } else {
       label = result.matrix.add(node, 0, 0, _maxPenalty);
     }
+    if (kTarget)
+      label.bound(lowerBound(_network.nodeStop(node), &result));
     ++numOpened;
     queue.push(label);
     assert(label.at() == node);
     // If a full Dijkstra is started from a hub, expand walking arcs for the
     // departure nodes
-    const int depStop = _network.node(label.at()).stop();
-    if (destStop == INT_MAX && _hubs && contains(*_hubs, depStop)) {
-      expandWalkNode(label, destStop, &queue, &result, &numOpened,
-                     &numInactive);
+    if (kWalk && destStop == INT_MAX && isHub<kHubs>(node)) {
+      expandWalkNode<kTarget, kHubs>(label, destStop, &queue, &result,
+                                     &numOpened, &numInactive);
     }
   }
-  while ((destStop != INT_MAX && queue.size()) ||
+  while ((kTarget && destStop != INT_MAX && queue.size()) ||
          static_cast<int>(queue.size()) > numInactive) {
     ++result.numSettledLabels;
     LabelMatrix::Hnd label = queue.top();
@@ -242,24 +287,39 @@ void Dijkstra::findShortestPath(const vector<int>& depNodes,
       --numOpened;
       assert(numOpened >= 0);
       const int node = label.at();
-      const int stop = _network.node(node).stop();
+      const int stop = _network.nodeStop(node);
 
       // debug
 //       printf("Settling node at stop %d with (%d, %d), maxPenalty %d\n", stop,
 //              label.cost(), label.penalty(), label.maxPenalty());
 
       label.closed(true);
-      if (stop == destStop) {
+      // Skip labels whose paths are dominated by the paths found since they
+      // were queued.
+      if (kTarget && label.bound() &&
+          !result.destLabels.candidate(label.cost() + label.bound(),
+                                       label.penalty())) {
+        continue;
+      }
+      if (kTarget && stop == destStop) {
         // assert(result.destLabels.candidate(label.cost(), label.penalty()));
         if (result.destLabels.candidate(label.cost(), label.penalty())) {
           const LabelVec::Hnd parent = result.matrix.parent(label);
           result.destLabels.add(label, parent);
         }
       } else {
-        expandNode(label, &queue, &result, &numOpened, &numInactive);
-        if (_network.node(node).type() == Node::ARRIVAL) {
-          expandWalkNode(label, destStop, &queue, &result,
-                         &numOpened, &numInactive);
+        expandNode<kTarget, kHubs>(label, &queue, &result, &numOpened,
+                                   &numInactive);
+        if (kWalk && _network.nodeType(node) == Node::ARRIVAL) {
+          if (!walkArcs) {
+            expandWalkNode<kTarget, kHubs>(label, destStop, &queue, &result,
+                                           &numOpened, &numInactive);
+          } else if (kTarget && destStop != INT_MAX) {
+            // The walk arcs include the transfer buffer, the destination is
+            // reached by the walking time alone.
+            expandWalkway<kTarget, kHubs>(label, destStop, destStop, &queue,
+                                          &result, &numOpened, &numInactive);
+          }
         }
       }
     }
@@ -267,20 +327,28 @@ void Dijkstra::findShortestPath(const vector<int>& depNodes,
   assert(static_cast<int>(queue.size()) == numInactive);
 }
 
+template<bool kTarget, bool kHubs>
 inline
 void Dijkstra::expandNode(const LabelMatrix::Hnd& label,
                          PriorityQueue* queue,
                          QueryResult* result,
                          int* numOpened, int* numInactive) const {
   const vector<Arc>& adj = _network.adjacencyList(label.at());
+  // Vehicles are boarded by arcs from transfer nodes and by walking.
+  const bool boarding = _network.period() &&
+                        _network.nodeType(label.at()) != Node::ARRIVAL;
   for (auto it = adj.begin(), end = adj.end(); it != end; ++it) {
     const Arc& arc = *it;
-    addSuccessor(label, arc.cost(), arc.penalty(), false,
-                 arc.destination(), queue, result,
-                 numOpened, numInactive);
+    if ((boarding || arc.walk()) &&
+        !boards(arc.destination(), label.cost() + arc.cost()))
+      continue;
+    addSuccessor<kTarget, kHubs>(label, arc.cost(), arc.penalty(), arc.walk(),
+                                 arc.destination(), queue, result,
+                                 numOpened, numInactive);
   }
 }
 
+template<bool kTarget, bool kHubs>
 inline
 void Dijkstra::expandWalkNode(const LabelMatrix::Hnd& label,
                              const int destStop,
@@ -288,33 +356,71 @@ void Dijkstra::expandWalkNode(const LabelMatrix::Hnd& label,
                              QueryResult* result,
                              int* numOpened, int* numInactive) const {
   const int node = label.at();
-  const int stop = _network.node(node).stop();
+  const int stop = _network.nodeStop(node);
   const vector<Arc>& walkArcs = _network.walkwayList(stop);
   for (auto arc = walkArcs.begin(), end = walkArcs.end(); arc != end; ++arc) {
-    const int walkStopIndex = arc->destination();
-    assert(stop != walkStopIndex);
-    const Stop& walkStop = _network.stop(walkStopIndex);
-    int time = _network.node(node).time();
-    time += arc->cost() + TransitNetwork::TRANSFER_BUFFER;
-    // For the target do not consider the transfer buffer for the start node seq
-    if (walkStopIndex == destStop) {
-      time -= TransitNetwork::TRANSFER_BUFFER;
-    }
+    assert(stop != arc->destination());
+    expandWalkArc<kTarget, kHubs>(label, *arc, destStop, queue, result,
+                                  numOpened, numInactive);
+  }
+}
 
-    vector<int> nodes = _network.findStartNodeSequence(walkStop, time);
-    for (auto it2 = nodes.begin(), end = nodes.end(); it2 != end; ++it2) {
-      const int walkNode = *it2;
-      unsigned int cost = _network.node(walkNode).time() -
-                          _network.node(node).time();
-      // When reaching the target, use the actual time of travel
-      if (walkStopIndex == destStop) { cost = arc->cost(); }
-      const unsigned char penalty = arc->penalty();
-      addSuccessor(label, cost, penalty, true, walkNode, queue, result,
-                   numOpened, numInactive);
+template<bool kTarget, bool kHubs>
+inline
+void Dijkstra::expandWalkway(const LabelMatrix::Hnd& label,
+                            const int walkStop, const int destStop,
+                            PriorityQueue* queue,
+                            QueryResult* result,
+                            int* numOpened, int* numInactive) const {
+  // The walkway lists of networks with walk arcs are ordered by head stop.
+  const vector<Arc>& walkArcs =
+      _network.walkwayList(_network.nodeStop(label.at()));
+  const auto arc = std::lower_bound(walkArcs.begin(), walkArcs.end(),
+                                    walkStop,
+                                    [](const Arc& a, const int stop) {
+                                      return a.destination() < stop;
+                                    });
+  if (arc != walkArcs.end() && arc->destination() == walkStop) {
+    expandWalkArc<kTarget, kHubs>(label, *arc, destStop, queue, result,
+                                  numOpened, numInactive);
+  }
+}
+
+template<bool kTarget, bool kHubs>
+inline
+void Dijkstra::expandWalkArc(const LabelMatrix::Hnd& label, const Arc& arc,
+                            const int destStop,
+                            PriorityQueue* queue,
+                            QueryResult* result,
+                            int* numOpened, int* numInactive) const {
+  const int node = label.at();
+  const int walkStopIndex = arc.destination();
+  int time = _network.nodeTime(node);
+  time += arc.cost() + TransitNetwork::TRANSFER_BUFFER;
+  // For the target do not consider the transfer buffer for the start node seq
+  if (kTarget && walkStopIndex == destStop) {
+    time -= TransitNetwork::TRANSFER_BUFFER;
+  }
+
+  const TransitNetwork::StartNodeRange nodes =
+      _network.startNodes(walkStopIndex, time);
+  for (auto it2 = nodes.begin(), end = nodes.end(); it2 != end; ++it2) {
+    const int walkNode = *it2;
+    unsigned int cost = time - _network.nodeTime(node) +
+                        _network.waitTime(time, walkNode);
+    // When reaching the target, use the actual time of travel
+    if (kTarget && walkStopIndex == destStop) {
+      cost = arc.cost();
+    } else if (!boards(walkNode, label.cost() + cost)) {
+      continue;
     }
+    const unsigned char penalty = arc.penalty();
+    addSuccessor<kTarget, kHubs>(label, cost, penalty, true, walkNode, queue,
+                                 result, numOpened, numInactive);
   }
 }
 
+template<bool kTarget, bool kHubs>
 inline
 void Dijkstra::addSuccessor(const LabelMatrix::Hnd& parentLabel,
                            const unsigned int arcCost,
@@ -327,14 +433,19 @@ void Dijkstra::addSuccessor(const LabelMatrix::Hnd& parentLabel,
   const uint32_t cost = parentLabel.cost() + arcCost;
   const uint8_t penalty = parentLabel.penalty() + arcPenalty;
   uint8_t maxPenalty = parentLabel.maxPenalty();
+  // The penalty can only grow on the way to the destination, so the bound
+  // prunes like a destination label with the same penalty.
+  const unsigned int bound =
+      kTarget ? lowerBound(_network.nodeStop(succNode), result) : 0;
 
   if (penalty <= maxPenalty &&
-      cost <= _maxCost &&
-      result->destLabels.candidate(cost, penalty) &&
+      bound != static_cast<unsigned int>(Landmarks::INFINITE) &&
+      cost + bound <= _maxCost &&
+      (!kTarget || result->destLabels.candidate(cost + bound, penalty)) &&
       result->matrix.candidate(succNode, cost, penalty)) {
-    const Node::Type succType = _network.node(succNode).type();
-    const bool hub = isHub(parentLabel.at());
-    const bool succHub = isHub(succNode);
+    const Node::Type succType = _network.nodeType(succNode);
+    const bool hub = isHub<kHubs>(parentLabel.at());
+    const bool succHub = isHub<kHubs>(succNode);
     const bool nowInactive = (hub || (succHub && walk)) &&
                              (walk || succType == Node::TRANSFER);
     if (nowInactive && !parentLabel.inactive()) {
@@ -348,16 +459,40 @@ void Dijkstra::addSuccessor(const LabelMatrix::Hnd& parentLabel,
                                                 maxPenalty, walk,
                                                 inactive, parentLabel);
     assert(!label.closed());
+    label.bound(bound);
     queue->push(label);
     *numOpened += !oldContained || oldClosed;
     *numInactive += inactive;
   }
 }
 
+inline
+bool Dijkstra::boards(const int node, const unsigned int cost) const {
+  const int period = _network.period();
+  if (!period || _network.nodeType(node) != Node::DEPARTURE)
+    return true;
+  const int time = _startTime + cost;
+  // Times before the node's first day give negative days, on which it does
+  // not run.
+  const int offset = time - _network.nodeTime(node);
+  const int day = offset / period - (offset % period < 0 ? 1 : 0);
+  return _network.runs(node, day);
+}
+
+inline
+unsigned int Dijkstra::lowerBound(const int stop, QueryResult* result) const {
+  if (result->lowerBounds.empty())
+    return 0;
+  unsigned int& bound = result->lowerBounds[stop];
+  if (bound == UINT_MAX)
+    bound = _landmarks->lowerBound(stop, result->destLabels.at());
+  return bound;
+}
+
+template<bool kHubs>
 inline
 bool Dijkstra::isHub(const int node) const {
-  const int stop = _network.node(node).stop();
-  return _hubs != NULL && contains(*_hubs, stop);
+  return kHubs && _hubs != NULL && _hubs->contains(_network.nodeStop(node));
 }
 
 // walk or transfer at a hub
@@ -380,6 +515,8 @@ unsigned char Dijkstra::maxHubPenalty() const {
 
 void Dijkstra::maxCost(const unsigned int cost) {
   _maxCost = cost;
+  if (_network.period())
+    _maxCost = min(cost, static_cast<unsigned int>(_network.period() - 1));
 }
 
 inline
@@ -396,6 +533,14 @@ const HubSet* Dijkstra::hubs() const {
   return _hubs;
 }
 
+void Dijkstra::landmarks(const Landmarks* landmarks) {
+  _landmarks = landmarks;
+}
+
+void Dijkstra::specialize(const bool specialize) {
+  _specialize = specialize;
+}
+
 void Dijkstra::startTime(const int startTime) {
   _startTime = startTime;
 }
@@ -485,9 +630,9 @@ QuerySearch::findOptimalPaths(const int startTime, const DirectConnection& dc,
           if (!label.walk()) {
             ++succPenalty;
             int walkSuccTime = std::numeric_limits<int>::max();
-            const vector<Arc>& walkingArcs = _network.walkway(stop, succStop);
-            if (walkingArcs.size()) {
-              walkSuccTime = time + walkingArcs[0].cost();
+            const int walkCost = _network.walkCost(stop, succStop);
+            if (walkCost != INT_MAX) {
+              walkSuccTime = time + walkCost;
               if (succNode != _graph.targetNode()) {
                 walkSuccTime += TransitNetwork::TRANSFER_BUFFER;
                 int earliestDep = std::numeric_limits<int>::max();
@@ -23,6 +23,8 @@ using std::priority_queue;
 using std::greater;
 // using google::dense_hash_map;
 
+class Arc;
+class Landmarks;
 class TransitNetwork;
 
 // Stores results of a shortest path query.
@@ -51,6 +53,10 @@ class QueryResult {
   // Number of settled labels.
   size_t numSettledLabels;
 
+  // The lower bounds of the costs from each stop to the destination stop,
+  // filled on demand by goal-directed searches.
+  vector<unsigned int> lowerBounds;
+
   // Clears all contents.
   void clear();
 
@@ -91,7 +97,8 @@ class Dijkstra {
   typedef priority_queue<LabelMatrix::Hnd, vector<LabelMatrix::Hnd>,
                          LabelMatrix::Hnd::Comp> PriorityQueue;
 
-  // Constructor
+  // Constructor. On periodic networks a search covers at most one period, so
+  // the maximum cost is set to period - 1 and maxCost() clamps to it.
   explicit Dijkstra(const TransitNetwork& network);
 
   void findShortestPath(const vector<int>& depNodes, const int destStop,
@@ -110,7 +117,8 @@ class Dijkstra {
   // Returns the maximum penalty from hubs considered during search.
   unsigned char maxHubPenalty() const;
 
-  // Sets the maximum cost in seconds considered during search.
+  // Sets the maximum cost in seconds considered during search. Clamped to
+  // period - 1 on periodic networks.
   void maxCost(const unsigned int cost);
 
   // Returns the maximum cost in seconds considered durchin search.
@@ -122,21 +130,55 @@ class Dijkstra {
   // Returns a const pointer to the set hubs.
   const HubSet* hubs() const;
 
+  // Sets the landmarks directing searches with a destination stop towards it,
+  // NULL for undirected searches. Their lower bounds must hold on the network.
+  void landmarks(const Landmarks* landmarks);
+
   // Sets the start time of the shortest path search on a network.
   void startTime(const int startTime);
 
   // Returns the set start time of the shortest path search.
   const int startTime() const;
 
+  // Sets whether searches run in a variant compiled for their settings, which
+  // is the default, or in the general variant. Used for benchmarks.
+  void specialize(const bool specialize);
+
  private:
+  // The search with its settings fixed at compile time: whether it has a
+  // destination stop, whether hubs are set and whether there are walkways.
+  // Disabled settings cost no checks during relaxation.
+  template<bool kTarget, bool kHubs, bool kWalk>
+  void search(const vector<int>& depNodes, const int destStop,
+              QueryResult* result) const;
+
   // Expands given node with its walkable successor nodes.
+  template<bool kTarget, bool kHubs>
   void expandWalkNode(const LabelMatrix::Hnd& label,
                       const int destStop,
                       PriorityQueue* queue,
                       QueryResult* result,
                       int* numOpened, int* numInactive) const;
 
+  // Expands given node with its walkable successor nodes at the given stop,
+  // if any.
+  template<bool kTarget, bool kHubs>
+  void expandWalkway(const LabelMatrix::Hnd& label,
+                     const int walkStop, const int destStop,
+                     PriorityQueue* queue,
+                     QueryResult* result,
+                     int* numOpened, int* numInactive) const;
+
+  // Expands given node with the successor nodes of the given walking arc.
+  template<bool kTarget, bool kHubs>
+  void expandWalkArc(const LabelMatrix::Hnd& label, const Arc& arc,
+                     const int destStop,
+                     PriorityQueue* queue,
+                     QueryResult* result,
+                     int* numOpened, int* numInactive) const;
+
   // Expands given node using the given arc label.
+  template<bool kTarget, bool kHubs>
   void expandNode(const LabelMatrix::Hnd& label,
                   PriorityQueue* queue,
                   QueryResult* result,
@@ -145,6 +187,7 @@ class Dijkstra {
   // Adds a successor label of given parent only if the resulting label is a
   // candidate for an optimal path and does not violate the maximum penalty and
   // maximum cost setting.
+  template<bool kTarget, bool kHubs>
   void addSuccessor(const LabelMatrix::Hnd& parentLabel,
                     const unsigned int cost,
                     const unsigned char penalty, const bool walk,
@@ -152,14 +195,25 @@ class Dijkstra {
                     QueryResult* result,
                     int* numOpened, int* numInactive) const;
 
+  // Returns whether the vehicle of the node runs when the node is reached at
+  // the given cost. Always true but for departures in periodic networks.
+  bool boards(const int node, const unsigned int cost) const;
+
+  // Returns the lower bound of the cost from the stop to the destination of a
+  // goal-directed search, 0 for other searches.
+  unsigned int lowerBound(const int stop, QueryResult* result) const;
+
+  template<bool kHubs>
   bool isHub(const int node) const;
   const TransitNetwork& _network;
   const Logger* _log;
   const HubSet* _hubs;
+  const Landmarks* _landmarks;
   unsigned char _maxPenalty;
   unsigned char _maxHubPenalty;
   unsigned int _maxCost;
   unsigned int _startTime;
+  bool _specialize;
 };
 
 
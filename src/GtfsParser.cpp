@@ -1,9 +1,11 @@
 // Copyright 2011: Eugen Sawin, Philip Stahl, Jonas Sternisko
 #include "./GtfsParser_impl.h"
 #include <assert.h>
+#include <omp.h>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/date_time/gregorian/gregorian.hpp>
 #include <algorithm>
+#include <iterator>
 #include <string>
 #include <vector>
 #include <map>
@@ -16,10 +18,14 @@ using std::ifstream;
 using std::ofstream;
 using boost::posix_time::from_iso_string;
 using boost::gregorian::date;
-using boost::gregorian::day_iterator;
 
+// Minimum number of bytes per chunk when parsing stop_times.txt in parallel.
+static const size_t kMinStopTimesChunkSize = 1 << 20;
 
-GtfsParser::GtfsParser(Logger* log) : _data(new Data()), _log(log) {}
+
+GtfsParser::GtfsParser(Logger* log)
+    : _data(new Data()), _log(log), _periodic(false),
+      _expandFrequencies(true) {}
 
 
 GtfsParser::~GtfsParser() {
@@ -108,8 +114,8 @@ void
 GtfsParser::parseGtfs(const string& gtfsDirectory, TransitNetwork* network) {
   if (_log) _log->info("parsing GTFS files from " + gtfsDirectory);
 
-  // Collect the set of serviceIds active the current day.
-  _data->lastServiceActivity =
+  // Collect the days each service is active on.
+  _data->lastServiceCalendar =
       parseCalendarFile(gtfsDirectory + "/calendar.txt");
 
   // Collect the association between trip_id and service_id.
@@ -135,179 +141,345 @@ void GtfsParser::translateLastTripsToNetwork(const string& startTimeStr,
   if (_log)
     _log->info("constructing the TransitNetwork for time period from %s to %s",
                startTimeStr.c_str(), endTimeStr.c_str());
-  const ActivityMap& serviceActivity = _data->lastServiceActivity;
-  const map<string, string>& trip2Service = _data->lastTrip2Service;
+  const ServiceCalendar& calendar = _data->lastServiceCalendar;
+  const vector<int>& trip2Service = _data->lastTrip2Service;
   const FrequencyMap& frequencies = _data->lastFrequencies;
   const vector<Trip>& gtfsTrips   = _data->lastGtfsTrips;
 
-  // Process all the data read: Iterate over the the date period
-  date start = from_iso_string(startTimeStr).date();
-  date end   = from_iso_string(endTimeStr).date();
-  for (day_iterator dayIt = day_iterator(start); dayIt <= end; ++dayIt) {
-    const int t0 = 24 * 60 * 60 * (*dayIt - date(1970, 1, 1)).days();
-    // Process each block of stops from stop_times.txt
-    for (auto iter = gtfsTrips.cbegin(); iter != gtfsTrips.end(); ++iter) {
-      const Trip& trip = *iter;
-      if (trip.size() > 1) {
-        // Skip trips that are not active today
-        if (isActive(trip2Service.at(trip.id()), serviceActivity, *dayIt)) {
-          // Gernerate all arrival, transfer and departure nodes for this trip
-          generateTripNodes(trip, frequencies, t0, network);
-          // Collect direct connection data (same trip may go at multiple days)
-          if (trips) addTrip(trip, t0, trips);
-        }
-      }
+  // Count the nodes and arcs of each trip of stop_times.txt. They are the
+  // same on each day the trip is active.
+  const int numGtfsTrips = gtfsTrips.size();
+  vector<int> tripNodes(numGtfsTrips, 0);
+  vector<int> tripArcs(numGtfsTrips, 0);
+  #pragma omp parallel for schedule(dynamic, 256)
+  for (int i = 0; i < numGtfsTrips; ++i) {
+    const Trip& trip = gtfsTrips[i];
+    if (trip.size() > 1) {
+      const int numRuns =
+          _expandFrequencies ? this->numRuns(trip.index(), frequencies) : 1;
+      tripNodes[i] = numRuns * 3 * trip.size();
+      tripArcs[i] = numRuns * (3 * trip.size() - 1);
     }
   }
-}
 
+  // Collect the trips active on each day of the period and the offsets of
+  // their nodes in the order a day by day, trip by trip construction yields.
+  const date epoch(1970, 1, 1);
+  const int start = (from_iso_string(startTimeStr).date() - epoch).days();
+  const int end   = (from_iso_string(endTimeStr).date() - epoch).days();
+  const size_t firstNode = network->numNodes();
+  if (firstNode == 0) {
+    network->_timeEpoch = 24 * 60 * 60 * start;
+    network->_period = _periodic ? kSecondsPerDay : 0;
+  }
+  const bool periodic = network->_period != 0;
+  // The days of a periodic network are a bitmask of 64 days from its epoch,
+  // trips on days outside of them are left out.
+  const int epochDay = network->_timeEpoch / (24 * 60 * 60);
+  const int firstDay = periodic ? std::max(start, epochDay) : start;
+  const int lastDay = periodic ? std::min(end, epochDay + 63) : end;
+  if (firstDay != start || lastDay != end) {
+    if (_log) _log->error("periodic networks span at most 64 days from their "
+                          "first, the trips on other days are left out");
+  }
+  vector<TripRun> runs;
+  size_t numNodes = network->numNodes();
+  size_t numArcs = 0;
+  for (int day = firstDay; day <= lastDay; ++day) {
+    for (int i = 0; i < numGtfsTrips; ++i) {
+      const Trip& trip = gtfsTrips[i];
+      if (tripNodes[i] == 0)
+        continue;
+      // Skip trips that are not active today
+      const int service = trip.index() == -1 ? -1 : trip2Service[trip.index()];
+      if (isActive(service, calendar, day)) {
+        runs.push_back(TripRun(i, 24 * 60 * 60 * day, numNodes));
+        numNodes += tripNodes[i];
+        numArcs += tripArcs[i];
+      }
+    }
+  }
+  // A periodic network has the nodes of each trip once, at the first day.
+  vector<TripRun> periodicRuns;
+  if (periodic) {
+    vector<uint64_t> days(numGtfsTrips, 0);
+    for (auto run = runs.begin(); run != runs.end(); ++run)
+      days[run->trip] |= 1ull << (run->timeOffset / (24 * 60 * 60) - epochDay);
+    numNodes = network->numNodes();
+    numArcs = 0;
+    for (int i = 0; i < numGtfsTrips; ++i) {
+      if (days[i]) {
+        periodicRuns.push_back(TripRun(i, network->_timeEpoch, numNodes,
+                                       days[i]));
+        numNodes += tripNodes[i];
+        numArcs += tripArcs[i];
+      }
+    }
+  }
 
-bool GtfsParser::isActive(const string& serviceId,
-                          const ActivityMap& activityMap,
-                          const date& day) {
-  const Activity& activity = activityMap.find(serviceId)->second;
-  const int serviceDay   = convert<int>(to_iso_string(day));
-  const int serviceStart = activity.get<1>();
-  const int serviceEnd   = activity.get<2>();
-  // day of week 0 = sunday, 6 = saturday
-  int weekday = day.day_of_week().as_number();
-  // 0 = monday, 6 = sunday
-  weekday -= 1;
-  if (weekday == -1) weekday = 6;
-  assert(weekday >= 0 && weekday < 7);
-  return serviceStart <= serviceDay &&
-         serviceDay <= serviceEnd &&
-         activity.get<0>()[weekday];
-}
-
-vector<int>
-GtfsParser::generateStartTimes(const string& tripId,
-                               const FrequencyMap& frequencies) const {
-  vector<int> tripStartTimes;
-  FrequencyMap::const_iterator it = frequencies.find(tripId);
-  if (it != frequencies.end()) {
-    for (size_t i = 0; i < it->second.size(); i++) {
-      const Frequency& f = it->second[i];
-      for (int time = f.start; time < f.finish; time += f.frequency) {
-        tripStartTimes.push_back(time);
+  // Generate all arrival, transfer and departure nodes of the trips in
+  // parallel into the preallocated node and arc lists.
+  network->resizeNodes(numNodes);
+  network->_numArcs += numArcs;
+  const vector<TripRun>& nodeRuns = periodic ? periodicRuns : runs;
+  const int numNodeRuns = nodeRuns.size();
+  #pragma omp parallel for schedule(dynamic, 64)
+  for (int i = 0; i < numNodeRuns; ++i) {
+    const TripRun& run = nodeRuns[i];
+    generateTripNodes(gtfsTrips[run.trip], frequencies, run.timeOffset,
+                      run.firstNode, network);
+    if (periodic)
+      foldTripNodes(run, tripNodes[run.trip], network);
+  }
+  // Collect direct connection data (same trip may go at multiple days). A trip
+  // with frequencies yields one trip with a headway per frequency.
+  if (trips) {
+    const int numRuns = runs.size();
+    vector<size_t> firstTrips(numRuns + 1, trips->size());
+    for (int i = 0; i < numRuns; ++i) {
+      FrequencyMap::const_iterator it =
+          frequencies.find(gtfsTrips[runs[i].trip].index());
+      firstTrips[i + 1] = firstTrips[i] +
+          (it == frequencies.end() ? 1 : it->second.size());
+    }
+    trips->resize(firstTrips[numRuns]);
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int i = 0; i < numRuns; ++i) {
+      const Trip& trip = gtfsTrips[runs[i].trip];
+      FrequencyMap::const_iterator it = frequencies.find(trip.index());
+      if (it == frequencies.end()) {
+        (*trips)[firstTrips[i]] = absoluteTrip(trip, runs[i].timeOffset);
+        continue;
+      }
+      for (size_t j = 0; j < it->second.size(); ++j) {
+        const Frequency& f = it->second[j];
+        Trip& t = (*trips)[firstTrips[i] + j];
+        t = absoluteTrip(trip,
+                         runs[i].timeOffset + f.start - trip.time().dep(0));
+        t.frequency(f.frequency, f.numRuns());
       }
     }
-  } else {
-    tripStartTimes.push_back(0);
   }
-  return tripStartTimes;
+
+  // Register the new nodes at their stops in node order.
+  for (size_t i = firstNode; i < numNodes; ++i)
+    network->stop(network->nodeStop(i)).addNodeIndex(i);
 }
 
 
-void GtfsParser::addTrip(const Trip& trip, const int timeOffset,
-                         vector<Trip>* trips) const {
-  assert(trips);
-  LineFactory lf;
+void GtfsParser::foldTripNodes(const TripRun& run, const size_t numNodes,
+                               TransitNetwork* network) const {
+  const int period = network->_period;
+  for (size_t node = run.firstNode; node < run.firstNode + numNodes; ++node) {
+    // Nodes after midnight take place on the days after the run's start.
+    const int time = network->_nodeTimes[node];
+    assert(time >= 0);
+    const int day = time / period;
+    network->_nodeTimes[node] = time - day * period;
+    network->_nodeDays[node] = day < 64 ? run.days << day : 0;
+  }
+}
+
+
+bool GtfsParser::isActive(const int service, const ServiceCalendar& calendar,
+                          const int day) const {
+  return service >= 0 && static_cast<size_t>(service) < calendar.size() &&
+         calendar[service].active(day);
+}
+
+int GtfsParser::numRuns(const int tripIndex,
+                        const FrequencyMap& frequencies) const {
+  FrequencyMap::const_iterator it = frequencies.find(tripIndex);
+  if (it == frequencies.end())
+    return 1;
+  int numRuns = 0;
+  for (size_t i = 0; i < it->second.size(); i++)
+    numRuns += it->second[i].numRuns();
+  return numRuns;
+}
+
+
+Trip GtfsParser::absoluteTrip(const Trip& trip, const int timeOffset) const {
   vector<Int64Pair> times;
   vector<int> stops;
+  times.reserve(trip.size());
+  stops.reserve(trip.size());
   for (int line = 0; line < trip.size(); ++line) {
     times.push_back(make_pair(trip.time().arr(line) + timeOffset,
                               trip.time().dep(line) + timeOffset));
     stops.push_back(trip.stop(line));
   }
-  trips->push_back(lf.createTrip(times, stops));
+  return LineFactory::createTrip(times, stops);
 }
 
 
 void GtfsParser::generateTripNodes(const Trip& trip,
                                    const FrequencyMap& frequencies,
-                                   const int timeOffset,
+                                   const int timeOffset, size_t nodeIndex,
                                    TransitNetwork* network) const {
-  const TripTime& times = trip.time();
-//   int firstArrivalTime = times.arr(0);
-
   // If a trip has a frequency we make the absolute times from
-  // stop_times.txt relative to the first arrival time. If a trip has no
+  // stop_times.txt relative to the first departure time. If a trip has no
   // frequency we take the absolute time stamp.
-  vector<int> tripStartTimes = generateStartTimes(trip.id(), frequencies);
-
-  for (size_t i = 0; i < tripStartTimes.size(); i++) {
-    const int tripStartTime = tripStartTimes[i];
-    // Remember departure node index from the previous stop
-    size_t prevDepartureIndex = 0;
-    // add nodes for each pair of arrival and departure in the stop block
-    for (int j = 0; j < trip.size(); j++) {
-      int stopIndex   = trip.stop(j);
-      int arrival     = times.arr(j);
-      int departure   = times.dep(j);
-      int waitingTime = departure - arrival;
-      assert(waitingTime >= 0);
-      // Make the times relative if we have a frequency
-      if (contains(frequencies, trip.id())) {
-        arrival   += tripStartTime/* - firstArrivalTime*/;
-        departure += tripStartTime/* - firstArrivalTime*/;
-      }
-      // Add the offset for the current day
-      arrival   += timeOffset;
-      departure += timeOffset;
-      // add the current arrival node
-      int arrivalIndex = network->addTransitNode(stopIndex, Node::ARRIVAL,
-                                                 arrival);
-      // add the travel arc from departure@LastStop -> arrival@CurrentStop
-      if (j > 0) {
-        int deltaT  = times.arr(j) - times.dep(j-1);
-        network->addArc(prevDepartureIndex, arrivalIndex, deltaT);
-        assert(network->node(prevDepartureIndex).stop() !=
-               network->node(arrivalIndex).stop());
-      }
-
-      // add the current departure node
-      int departureIndex = network->addTransitNode(stopIndex, Node::DEPARTURE,
-                                                   departure);
-      // add the waiting arc at from arrival@T to departure@T
-      network->addArc(arrivalIndex, departureIndex, waitingTime);
+  FrequencyMap::const_iterator it = frequencies.find(trip.index());
+  if (it == frequencies.end()) {
+    generateRunNodes(trip, timeOffset, nodeIndex, network);
+    return;
+  }
+  if (!_expandFrequencies) {
+    int start = it->second[0].start;
+    for (size_t i = 1; i < it->second.size(); i++)
+      start = std::min(start, it->second[i].start);
+    generateRunNodes(trip, timeOffset + start - trip.time().dep(0), nodeIndex,
+                     network);
+    return;
+  }
+  for (size_t i = 0; i < it->second.size(); i++) {
+    const Frequency& f = it->second[i];
+    for (int time = f.start; time < f.finish; time += f.frequency) {
+      nodeIndex = generateRunNodes(trip, timeOffset + time - trip.time().dep(0),
+                                   nodeIndex, network);
+    }
+  }
+}
 
-      // add the current transfer node
-      int transferIndex = network->addTransitNode(stopIndex, Node::TRANSFER,
-                                     arrival + TransitNetwork::TRANSFER_BUFFER);
-      // add the transfer arc from arrival@T to transfer@T with PENALTY of 1
-      network->addArc(arrivalIndex, transferIndex,
-                      TransitNetwork::TRANSFER_BUFFER, 1);
 
-      prevDepartureIndex = departureIndex;
+size_t GtfsParser::generateRunNodes(const Trip& trip, const int timeOffset,
+                                    size_t nodeIndex,
+                                    TransitNetwork* network) const {
+  vector<vector<Arc> >& arcs = network->_adjacencyLists;
+  const TripTime& times = trip.time();
+  // Remember departure node index from the previous stop
+  size_t prevDepartureIndex = 0;
+  // add nodes for each pair of arrival and departure in the stop block
+  for (int j = 0; j < trip.size(); j++) {
+    int stopIndex   = trip.stop(j);
+    int arrival     = times.arr(j) + timeOffset;
+    int departure   = times.dep(j) + timeOffset;
+    int waitingTime = departure - arrival;
+    assert(waitingTime >= 0);
+    assert(stopIndex >= 0 &&
+           stopIndex < static_cast<int>(network->numStops()));
+    // add the current arrival node
+    const size_t arrivalIndex = nodeIndex++;
+    network->setNode(arrivalIndex, stopIndex, Node::ARRIVAL, arrival);
+    // add the travel arc from departure@LastStop -> arrival@CurrentStop
+    if (j > 0) {
+      int deltaT  = times.arr(j) - times.dep(j-1);
+      assert(deltaT >= 0);
+      arcs[prevDepartureIndex].assign(1, Arc(arrivalIndex, deltaT, 0));
+      assert(network->nodeStop(prevDepartureIndex) != stopIndex);
     }
+
+    // add the current departure node
+    const size_t departureIndex = nodeIndex++;
+    network->setNode(departureIndex, stopIndex, Node::DEPARTURE, departure);
+    // add the current transfer node
+    const size_t transferIndex = nodeIndex++;
+    network->setNode(transferIndex, stopIndex, Node::TRANSFER,
+                     arrival + TransitNetwork::TRANSFER_BUFFER);
+
+    // add the waiting arc at from arrival@T to departure@T and the transfer
+    // arc from arrival@T to transfer@T with PENALTY of 1
+    vector<Arc>& arrivalArcs = arcs[arrivalIndex];
+    arrivalArcs.reserve(2);
+    arrivalArcs.push_back(Arc(departureIndex, waitingTime, 0));
+    arrivalArcs.push_back(Arc(transferIndex,
+                              TransitNetwork::TRANSFER_BUFFER, 1));
+
+    prevDepartureIndex = departureIndex;
   }
+  return nodeIndex;
 }
 
 
 void GtfsParser::generateInterTripArcs(TransitNetwork* network) const {
-  const vector<Node>& nodes = network->_nodes;
-  for (size_t i = 0; i < network->numStops(); i++) {
-    Stop& stop = network->stop(i);
-    // sort the vector of node indices according to the time of the node
-    sort(stop.nodesBegin(), stop.nodesEnd(), CompareNodesByTime(&nodes));
-    // for each transfer node, we add arcs to all subsequent departure nodes
-    // until the next transfer node, to which we add an arc as well
-    for (int k = 0; k < stop.numNodes(); k++) {
-      int currNodeIndex = stop.nodeIndex(k);
-      if (nodes[currNodeIndex].type() == Node::TRANSFER) {
-        for (int j = k + 1; j < stop.numNodes(); j++) {
-          int nextNodeIndex = stop.nodeIndex(j);
-          int waitTime = nodes[nextNodeIndex].time() -
-                         nodes[currNodeIndex].time();
-          assert(waitTime >= 0);
-          if (nodes[nextNodeIndex].type() == Node::DEPARTURE) {
-            network->addArc(currNodeIndex, nextNodeIndex, waitTime);
-          } else if (nodes[nextNodeIndex].type() == Node::TRANSFER) {
-            network->addArc(currNodeIndex, nextNodeIndex, waitTime);
-            break;
+  const int numStops = network->numStops();
+  const int period = network->_period;
+  if (period) {
+    // Only the transfer nodes at the end of the period have its end time.
+    const int endTime = network->_timeEpoch + period;
+    for (int i = 0; i < numStops; i++) {
+      const vector<int>& nodes = network->stop(i).getNodeIndices();
+      bool hasEnd = nodes.empty();
+      for (auto it = nodes.begin(); !hasEnd && it != nodes.end(); ++it)
+        hasEnd = network->nodeTime(*it) == endTime;
+      if (!hasEnd)
+        network->addTransitNode(i, Node::TRANSFER, endTime);
+    }
+  }
+  vector<int>& offsets = network->_stopTimeOffsets;
+  vector<int>& nodes = network->_stopNodes;
+  vector<int>& times = network->_stopTimes;
+  offsets.assign(1, 0);
+  offsets.reserve(numStops + 1);
+  for (int i = 0; i < numStops; i++)
+    offsets.push_back(offsets.back() + network->stop(i).numNodes());
+  nodes.resize(offsets.back());
+  times.resize(offsets.back());
+
+  size_t numArcs = 0;
+  #pragma omp parallel reduction(+: numArcs)
+  {
+    // The nodes of a stop as keys of time, rank and node index. Sorting them
+    // orders by time and puts transfer nodes before departure nodes.
+    vector<uint64_t> keys;
+    #pragma omp for schedule(dynamic, 16)
+    for (int i = 0; i < numStops; i++) {
+      Stop& stop = network->stop(i);
+      keys.clear();
+      for (auto it = stop.nodesBegin(); it != stop.nodesEnd(); ++it) {
+        // Flipping the sign bit maps signed times to ordered unsigned values.
+        const uint64_t time =
+            static_cast<uint32_t>(network->nodeTime(*it)) ^ 0x80000000u;
+        const uint64_t rank = network->nodeType(*it) == Node::TRANSFER ? 0 : 1;
+        assert(*it >= 0);
+        keys.push_back(time << 32 | rank << 31 | static_cast<uint64_t>(*it));
+      }
+      sort(keys.begin(), keys.end());
+      int* stopNodes = nodes.data() + offsets[i];
+      int* stopTimes = times.data() + offsets[i];
+      for (size_t k = 0; k < keys.size(); k++) {
+        stopNodes[k] = keys[k] & 0x7fffffff;
+        stop.nodesBegin()[k] = stopNodes[k];
+        stopTimes[k] = network->nodeTime(stopNodes[k]);
+      }
+      // for each transfer node, we add arcs to all subsequent departure nodes
+      // until the next transfer node, to which we add an arc as well. In
+      // periodic networks the last transfer node continues at the first node.
+      const int numStopNodes = keys.size();
+      for (int k = 0; k < numStopNodes; k++) {
+        int currNodeIndex = stopNodes[k];
+        if (network->nodeType(currNodeIndex) == Node::TRANSFER) {
+          vector<Arc>& arcs = network->_adjacencyLists[currNodeIndex];
+          const size_t numOldArcs = arcs.size();
+          const int last = period ? k + numStopNodes : numStopNodes;
+          for (int l = k + 1; l < last; l++) {
+            const int j = l % numStopNodes;
+            int nextNodeIndex = stopNodes[j];
+            int waitTime = stopTimes[j] - stopTimes[k] + (l > j ? period : 0);
+            assert(waitTime >= 0);
+            const Node::Type nextType = network->nodeType(nextNodeIndex);
+            if (nextType == Node::DEPARTURE) {
+              arcs.push_back(Arc(nextNodeIndex, waitTime, 0));
+            } else if (nextType == Node::TRANSFER) {
+              arcs.push_back(Arc(nextNodeIndex, waitTime, 0));
+              break;
+            }
           }
+          numArcs += arcs.size() - numOldArcs;
         }
       }
     }
   }
+  network->_numArcs += numArcs;
+  network->buildStopTimeIndex();
 }
 
 
 int GtfsParser::removeInterTripArcs(TransitNetwork* network) const {
   int removed = 0;
-  for (size_t i = 0; i < network->_nodes.size(); ++i) {
-    if (network->_nodes[i].type() == Node::TRANSFER) {
+  for (size_t i = 0; i < network->numNodes(); ++i) {
+    if (network->nodeType(i) == Node::TRANSFER) {
       removed += network->_adjacencyLists[i].size();
       network->_adjacencyLists[i] = vector<Arc>();
     }
@@ -329,9 +501,11 @@ map<string, int> GtfsParser::parseFields(const string& filename) const {
 }
 
 
-GtfsParser::ActivityMap GtfsParser::parseCalendarFile(const string& filename) {
-  ActivityMap serviceIds;
-  serviceIds.set_empty_key("");
+GtfsParser::ServiceCalendar
+GtfsParser::parseCalendarFile(const string& filename) {
+  IdMap& serviceIds = _data->lastServiceIds;
+  serviceIds.clear();
+  ServiceCalendar calendar;
   map<string, int> field_map = parseFields(filename);
   CsvParser parser;
 
@@ -349,36 +523,48 @@ GtfsParser::ActivityMap GtfsParser::parseCalendarFile(const string& filename) {
   while (not parser.eof()) {
     parser.readNextLine();
     if (parser.getNumColumns() > 0) {
-      string serviceId = parser.getItem(field_map["service_id"]);
-      int startDate = convert<int>(parser.getItem(field_map["start_date"]));
-      int endDate = convert<int>(parser.getItem(field_map["end_date"]));
-      Activity activity(0, startDate, endDate);
+      const int service = serviceIds.intern(
+          parser.getItem(field_map["service_id"]));
+      const int firstDay =
+          gtfsDate2Day(parser.getItem(field_map["start_date"]));
+      const int lastDay = gtfsDate2Day(parser.getItem(field_map["end_date"]));
+      bool weekdays[7];
       for (size_t i = 0; i < 7; ++i)
-        activity.get<0>()[i] = convert<bool>(parser.getItem(dayIndices[i]));
-      serviceIds[serviceId] = activity;
+        weekdays[i] = convert<bool>(parser.getItem(dayIndices[i]));
+      if (calendar.size() <= static_cast<size_t>(service))
+        calendar.resize(service + 1);
+      ServiceDays& days = calendar[service];
+      days.firstDay = firstDay;
+      days.days.clear();
+      days.days.resize(std::max(lastDay - firstDay + 1, 0));
+      // 1970-01-01 was a thursday, weekdays are counted from monday.
+      for (int day = firstDay; day <= lastDay; ++day)
+        days.days[day - firstDay] = weekdays[(day + 3) % 7];
     }
   }
   parser.closeFile();
-  return serviceIds;
+  return calendar;
 }
 
 
-map<string, string> GtfsParser::parseTripsFile(const string& filename) {
-  map<string, string> tripsAndService;
+vector<int> GtfsParser::parseTripsFile(const string& filename) {
+  IdMap& tripIds = _data->lastTripIds;
+  tripIds.clear();
+  vector<int> trip2Service;
   map<string, int> field_map = parseFields(filename);
   CsvParser parser;
   parser.openFile(filename);
   while (not parser.eof()) {
     parser.readNextLine();
     if (parser.getNumColumns() > 0) {
-      const string tripId    = parser.getItem(field_map["trip_id"]);
-      const string serviceId = parser.getItem(field_map["service_id"]);
-      assert(!contains(tripsAndService, tripId));
-      tripsAndService[tripId] = serviceId;
+      const int trip = tripIds.intern(parser.getItem(field_map["trip_id"]));
+      assert(static_cast<size_t>(trip) == trip2Service.size());
+      trip2Service.push_back(_data->lastServiceIds.intern(
+          parser.getItem(field_map["service_id"])));
     }
   }
   parser.closeFile();
-  return tripsAndService;
+  return trip2Service;
 }
 
 
@@ -425,7 +611,7 @@ void GtfsParser::parseStopsFile(const string& filename,
 GtfsParser::FrequencyMap
 GtfsParser::parseFrequenciesFile(const string& filename) {
   FrequencyMap frequencies;
-  frequencies.set_empty_key("");
+  frequencies.set_empty_key(-1);
   // Check if the optional frequencies.txt exists
   std::ifstream fstream;
   fstream.open(filename.c_str());
@@ -433,12 +619,6 @@ GtfsParser::parseFrequenciesFile(const string& filename) {
     if (_log) _log->info("no frequencies.txt found");
     return frequencies;
   }
-  // TODO(jonas): Support frequencies. Currently it causes a problem with
-  // generation of scenarios, because later in the parser the 'firstArrivalTime'
-  // is considered if there are frequencies. So for now, we don't us them.
-  if (_log) _log->error("frequencies.txt found -- NOT SUPPORTED!");
-  return frequencies;
-
   // map row indices from the header of the file
   map<string, int> field_map = parseFields(filename);
   const int trip_id_index      = field_map["trip_id"];
@@ -451,14 +631,15 @@ GtfsParser::parseFrequenciesFile(const string& filename) {
   while (not parser.eof()) {
     parser.readNextLine();
     if (parser.getNumColumns() > 0) {
-      const string tripId = parser.getItem(trip_id_index);
+      const int trip = _data->lastTripIds.find(parser.getItem(trip_id_index));
+      if (trip == -1)
+        continue;
       const int startTime = gtfsTimeStr2Sec(parser.getItem(start_time_index));
       const int endTime   = gtfsTimeStr2Sec(parser.getItem(end_time_index));
       const int headwaySecs = convert<int>(parser.getItem(headway_secs_index));
-      // frequency is a map from <string> to <pointer to vector>
-      if (!contains(frequencies, tripId))
-        frequencies[tripId] = vector<Frequency>();
-      frequencies[tripId].push_back(Frequency(startTime, endTime, headwaySecs));
+      if (headwaySecs <= 0 || endTime <= startTime)
+        continue;
+      frequencies[trip].push_back(Frequency(startTime, endTime, headwaySecs));
     }
   }
   parser.closeFile();
@@ -467,96 +648,182 @@ GtfsParser::parseFrequenciesFile(const string& filename) {
 
 
 vector<Trip> GtfsParser::parseStopTimesFile(const string& filename,
-                                            const TransitNetwork& network) {
+                                            const TransitNetwork& network,
+                                            int numChunks) {
   // map row indices from the header of the file
   map<string, int> field_map = parseFields(filename);
-  const int trip_id_index        = field_map["trip_id"];
-  const int arrival_time_index   = field_map["arrival_time"];
-  const int departure_time_index = field_map["departure_time"];
-  const int stop_id_index        = field_map["stop_id"];
 
+  // Split the records into chunks of about equal byte size. The boundaries
+  // are aligned to line starts, quoted line breaks do not occur in the fields
+  // of stop_times.txt.
+  CsvParser parser;
+  parser.openFile(filename);
+  const size_t begin = parser.offset();
+  const size_t size = parser.fileSize() - begin;
+  if (numChunks <= 0) {
+    numChunks = std::min(static_cast<size_t>(4 * omp_get_max_threads()),
+                         size / kMinStopTimesChunkSize);
+  }
+  numChunks = std::max(numChunks, 1);
+  vector<size_t> bounds(numChunks + 1, parser.fileSize());
+  bounds[0] = begin;
+  for (int i = 1; i < numChunks; ++i) {
+    bounds[i] = std::max(bounds[i - 1],
+                         parser.lineStart(begin + size * i / numChunks));
+  }
+  parser.closeFile();
+
+  vector<vector<Trip> > chunkTrips(numChunks);
+  #pragma omp parallel for schedule(dynamic)
+  for (int i = 0; i < numChunks; ++i) {
+    parseStopTimesChunk(filename, field_map, bounds[i], bounds[i + 1], network,
+                        &chunkTrips[i]);
+  }
+
+  size_t numTrips = 0;
+  for (int i = 0; i < numChunks; ++i)
+    numTrips += chunkTrips[i].size();
   vector<Trip> trips;
+  trips.reserve(numTrips);
+  for (int i = 0; i < numChunks; ++i) {
+    trips.insert(trips.end(), std::make_move_iterator(chunkTrips[i].begin()),
+                 std::make_move_iterator(chunkTrips[i].end()));
+  }
+  return trips;
+}
+
+
+void GtfsParser::parseStopTimesChunk(const string& filename,
+                                     const map<string, int>& field_map,
+                                     const size_t begin, const size_t end,
+                                     const TransitNetwork& network,
+                                     vector<Trip>* trips) const {
+  const int trip_id_index        = field_map.find("trip_id")->second;
+  const int arrival_time_index   = field_map.find("arrival_time")->second;
+  const int departure_time_index = field_map.find("departure_time")->second;
+  const int stop_id_index        = field_map.find("stop_id")->second;
+  const IdMap& tripIds = _data->lastTripIds;
+  // Reused buffers for the id lookups.
+  string tripId, stopId;
+
   CsvParser parser;
   parser.openFile(filename);
+  if (begin == end) {
+    parser.closeFile();
+    return;
+  }
+  // A trip belongs to the chunk containing its first record. Skip the records
+  // continuing the trip of the preceding record, the previous chunk reads them.
+  string previousTripId;
+  if (begin != parser.offset()) {
+    parser.seek(parser.previousLineStart(begin));
+    parser.readNextLine();
+    if (parser.getNumColumns() > static_cast<size_t>(trip_id_index))
+      previousTripId = parser.field(trip_id_index).str();
+  }
+  parser.seek(begin);
+  size_t recordStart = begin;
   parser.readNextLine();
+  while (!parser.eof() && previousTripId != "" && parser.getNumColumns() > 0 &&
+         parser.field(trip_id_index) == previousTripId) {
+    recordStart = parser.offset();
+    parser.readNextLine();
+  }
 
-  while (!parser.eof()) {
-    if (parser.getNumColumns() == 0)
+  while (!parser.eof() && recordStart < end) {
+    if (parser.getNumColumns() == 0) {
+      recordStart = parser.offset();
+      parser.readNextLine();
       continue;
+    }
     // collect a block from stop_times.txt, reduce times to time differences
-    Trip trip(parser.getItem(trip_id_index));
-    addStopToTrip(parser.getItem(arrival_time_index),
-                  parser.getItem(departure_time_index),
-                  network.stopIndex(parser.getItem(stop_id_index)), &trip);
+    const CsvField& tripField = parser.field(trip_id_index);
+    tripId.assign(tripField.data(), tripField.size());
+    Trip trip(tripId, tripIds.find(tripId));
+    const CsvField& stopField = parser.field(stop_id_index);
+    stopId.assign(stopField.data(), stopField.size());
+    addStopToTrip(parser.field(arrival_time_index),
+                  parser.field(departure_time_index),
+                  network.stopIndex(stopId), &trip);
+    recordStart = parser.offset();
     parser.readNextLine();
-    while (!parser.eof() && parser.getItem(trip_id_index) == trip.id()) {
-      if (parser.getNumColumns() > 0) {
-        const string stopIndexStr = parser.getItem(stop_id_index);
-        if (network.stopIndex(stopIndexStr) != trip.stops().back()) {
-          addStopToTrip(parser.getItem(arrival_time_index),
-                        parser.getItem(departure_time_index),
-                        network.stopIndex(stopIndexStr), &trip);
-        } else {
-          // update the departure time of the last stop
-          int departure = gtfsTimeStr2Sec(parser.getItem(departure_time_index));
-          trip.tripTime().back().first = departure;
-        }
+    // The last trip of the chunk is completed beyond its end.
+    while (!parser.eof() && parser.getNumColumns() > 0 &&
+           parser.field(trip_id_index) == trip.id()) {
+      const CsvField& stopField = parser.field(stop_id_index);
+      stopId.assign(stopField.data(), stopField.size());
+      const int stopIndex = network.stopIndex(stopId);
+      if (stopIndex != trip.stops().back()) {
+        addStopToTrip(parser.field(arrival_time_index),
+                      parser.field(departure_time_index), stopIndex, &trip);
+      } else {
+        // update the departure time of the last stop
+        int departure = gtfsTimeStr2Sec(parser.field(departure_time_index));
+        trip.tripTime().back().first = departure;
       }
+      recordStart = parser.offset();
       parser.readNextLine();
     }
-    trips.push_back(trip);
+    trips->push_back(trip);
   }
   parser.closeFile();
-
-  return trips;
 }
 
 
 inline void
-GtfsParser::addStopToTrip(const string& arrTimeStr, const string& depTimeStr,
-                          const int stopIndex, Trip* trip) {
+GtfsParser::addStopToTrip(const CsvField& arrTime, const CsvField& depTime,
+                          const int stopIndex, Trip* trip) const {
   assert(trip);
   // If no arrival or departure time is given, take the one from the preceding
   // stop. See: http://code.google.com/intl/de-DE/transit/spec/transit_ ...
   // feed_specification.html#stop_times_txt___Field_Definitions
   int arrival, departure;
-  if (arrTimeStr == "")
+  if (arrTime.empty())
     arrival = trip->time().arr(trip->time().size() - 1);
   else
-    arrival = gtfsTimeStr2Sec(arrTimeStr);
-  if (depTimeStr == "")
+    arrival = gtfsTimeStr2Sec(arrTime);
+  if (depTime.empty())
     departure = trip->time().dep(trip->time().size() - 1);
   else
-    departure = gtfsTimeStr2Sec(depTimeStr);
+    departure = gtfsTimeStr2Sec(depTime);
   trip->addStop(arrival, departure, stopIndex);
 }
 
 
+int GtfsParser::gtfsDate2Day(const string& dateStr) const {
+  const int value = convert<int>(dateStr);
+  return (date(value / 10000, value / 100 % 100, value % 100) -
+          date(1970, 1, 1)).days();
+}
+
+
 int GtfsParser::gtfsTimeStr2Sec(const string& timesStr) {
-  string timeString = timesStr;
+  CsvField time(timesStr.data(), timesStr.size());
+  // Remove the quotes if they are present
+  if (time.size() > 1 && time[0] == '"' && time[time.size() - 1] == '"')
+    time = CsvField(time.data() + 1, time.size() - 2);
+  return gtfsTimeStr2Sec(time);
+}
 
+
+int GtfsParser::gtfsTimeStr2Sec(const CsvField& time) const {
   // Check that the string contains ":"
-  if (timeString.find(":") == string::npos) {
+  if (!memchr(time.data(), ':', time.size())) {
     return INT_MAX;
   }
-
-  // Remove the quotes if they are present
-  if (timeString.at(0) == '"')
-    timeString = timeString.substr(1);
-  if (timeString.at(timeString.length() - 1) == '"')
-    timeString = timeString.substr(0, timeString.length() - 1);
-
-  char* p;
-  char* cStr = strtok_r(const_cast<char*>(timeString.c_str()), ":", &p);
+  // Sum up hours, minutes and seconds, skipping blanks like atoi.
+  static const int kFactors[] = {3600, 60, 1};
   int seconds = 0;
-  for (int i = 0; cStr != NULL; i++) {
-    if (i == 0)  // hours
-      seconds += atoi(cStr) * 3600;
-    else if (i == 1)  // minutes
-      seconds += atoi(cStr) * 60;
-    else if (i == 2)  // seconds
-      seconds += atoi(cStr);
-    cStr = strtok_r(NULL, ":", &p);
+  size_t pos = 0;
+  for (int i = 0; i < 3 && pos < time.size(); ++i) {
+    while (pos < time.size() && time[pos] == ' ')
+      ++pos;
+    int value = 0;
+    while (pos < time.size() && time[pos] >= '0' && time[pos] <= '9')
+      value = 10 * value + (time[pos++] - '0');
+    seconds += value * kFactors[i];
+    // Skip to the next component.
+    while (pos < time.size() && time[pos++] != ':') {}
   }
   return seconds;
 }
@@ -644,6 +911,16 @@ void GtfsParser::logger(Logger* const log) {
 }
 
 
+void GtfsParser::periodic(const bool periodic) {
+  _periodic = periodic;
+}
+
+
+void GtfsParser::expandFrequencies(const bool expand) {
+  _expandFrequencies = expand;
+}
+
+
 const GtfsParser::Data& GtfsParser::data() const {
   return *_data;
 }
@@ -2,10 +2,10 @@
 #ifndef SRC_GTFSPARSER_H_
 #define SRC_GTFSPARSER_H_
 
-#include <boost/tuple/tuple.hpp>
+#include <assert.h>
+#include <boost/dynamic_bitset.hpp>
 #include <google/dense_hash_set>
 #include <google/dense_hash_map>
-#include <bitset>
 #include <map>
 #include <string>
 #include <vector>
@@ -23,18 +23,67 @@ class Line;
 class Trip;
 class TransitNetwork;
 
+// Interns string ids to dense integer ids in the order of their first
+// occurrence.
+class IdMap {
+ public:
+  IdMap() { _indices.set_empty_key(""); }
+
+  // Returns the integer id of the string id, adding it if it is new.
+  int intern(const string& id) {
+    assert(!id.empty());
+    auto it = _indices.find(id);
+    if (it != _indices.end())
+      return it->second;
+    _indices[id] = _ids.size();
+    _ids.push_back(id);
+    return _ids.size() - 1;
+  }
+
+  // Returns the integer id of the string id or -1 if it is unknown.
+  int find(const string& id) const {
+    auto it = _indices.find(id);
+    return it == _indices.end() ? -1 : it->second;
+  }
+
+  // Returns the string id of an integer id.
+  const string& id(const int index) const { return _ids[index]; }
+
+  size_t size() const { return _ids.size(); }
+
+  void clear() {
+    _indices.clear();
+    _ids.clear();
+  }
+
+ private:
+  dense_hash_map<string, int> _indices;
+  vector<string> _ids;
+};
+
 
 class GtfsParser {
  public:
   // Forward declaration for private data types.
   class Frequency;
   class Data;
-  // Map for frequencies.
-  typedef dense_hash_map<string, vector<Frequency> > FrequencyMap;
-  // A tuple of weekday activity as bitset, start time and end time.
-  typedef boost::tuple<std::bitset<7>, int, int> Activity;
-  // A mapping indicating service activity for each weekday.
-  typedef dense_hash_map<string, Activity> ActivityMap;
+  class TripRun;
+  // Map for frequencies, keyed by interned trip id.
+  typedef dense_hash_map<int, vector<Frequency> > FrequencyMap;
+  // The days a service operates on. Bit i is set iff the service is active on
+  // day firstDay + i, counted in days since 1970-01-01.
+  struct ServiceDays {
+    ServiceDays() : firstDay(0) {}
+    bool active(const int day) const {
+      return day >= firstDay &&
+             static_cast<size_t>(day - firstDay) < days.size() &&
+             days.test(day - firstDay);
+    }
+    int firstDay;
+    boost::dynamic_bitset<> days;
+  };
+  // The service days for each interned service id.
+  typedef vector<ServiceDays> ServiceCalendar;
 
   // Constructor
   explicit GtfsParser(Logger* log = NULL);
@@ -81,66 +130,112 @@ class GtfsParser {
   // Set the logger to an external logger.
   void logger(Logger* const log);
 
+  // Sets whether the networks created are periodic with a period of one day,
+  // the trips have their nodes once with the days of the time period they run
+  // on. Searches on periodic networks need a start time. Default is false.
+  void periodic(const bool periodic);
+
+  // Sets whether trips with frequencies have the nodes of all their runs in
+  // the networks created. Otherwise they have the nodes of their first run
+  // only, so searches on the network and the transfer patterns computed on it
+  // miss the later runs, while the lines keep all runs as headways. Default
+  // is true.
+  void expandFrequencies(const bool expand);
+
   // Accesses the private data.
   const GtfsParser::Data& data() const;
 
  private:
-  // Check whether a service is active on a certain day.
-  bool isActive(const string& serviceId, const ActivityMap& activityMap,
-                const boost::gregorian::date& day);
+  // Check whether a service is active on a day, given in days since
+  // 1970-01-01. Unknown services (-1) are never active.
+  bool isActive(const int service, const ServiceCalendar& calendar,
+                const int day) const;
   FRIEND_TEST(GtfsParserTest, isActive);
 
-  // Generates the vector of starting times of a trip using frequencies.txt's
-  // content.
-  vector<int> generateStartTimes(const string& tripId,
-                                 const FrequencyMap& frequencies) const;
+  // Returns the number of runs of a trip: one if it has no frequencies,
+  // otherwise the sum of the runs of its frequencies.
+  int numRuns(const int tripIndex, const FrequencyMap& frequencies) const;
 
-  // Adds a trip for a trip of stop_times.txt converting its relative time
-  // stamps to absolute times.
-  void addTrip(const Trip& block, const int timeOffset,
-               vector<Trip>* trips) const;
+  // Returns a trip of stop_times.txt with its relative time stamps converted
+  // to absolute times.
+  Trip absoluteTrip(const Trip& trip, const int timeOffset) const;
 
   // Generates arrival, departure and transfer node for each stop of a trip
-  // (which is given as a block of stop_times.txt)
+  // (which is given as a block of stop_times.txt) and the arcs between them,
+  // for each of its runs or only its first run if frequencies are not
+  // expanded. The nodes are written to the preallocated slots starting at
+  // nodeIndex.
   void generateTripNodes(const Trip& trip, const FrequencyMap& frequencies,
-                         const int timeOffset, TransitNetwork* network) const;
+                         const int timeOffset, size_t nodeIndex,
+                         TransitNetwork* network) const;
+
+  // Generates the nodes and arcs of a single run of a trip, shifted by
+  // timeOffset, starting at nodeIndex. Returns the index after its last node.
+  size_t generateRunNodes(const Trip& trip, const int timeOffset,
+                          size_t nodeIndex, TransitNetwork* network) const;
+
+  // Moves the nodes of a trip run in a periodic network into the first period
+  // and sets the days they take place on from the days the run starts on.
+  void foldTripNodes(const TripRun& run, const size_t numNodes,
+                     TransitNetwork* network) const;
 
   // Sorts the nodes for each stop by time, add waiting arcs between transit
-  // nodes, and boarding arcs between transit and departure nodes.
+  // nodes, and boarding arcs between transit and departure nodes. Periodic
+  // networks get a transfer node at the end of the period at each stop, which
+  // waits for the nodes of the next period.
   void generateInterTripArcs(TransitNetwork* network) const;
+  FRIEND_TEST(GtfsParserTest, generateInterTripArcs);
 
   // Returns a field name -> column index map of given CSV file.
   map<string, int> parseFields(const string& filename) const;
 
-  // Parses the GTFS calendar file and create a mapping from service id to a
-  // bitset describing the active days and two integers for start and end of
-  // the service period.
-  GtfsParser::ActivityMap parseCalendarFile(const string& filename);
+  // Parses the GTFS calendar file. Interns the service ids anew and returns
+  // the days each service is active on.
+  GtfsParser::ServiceCalendar parseCalendarFile(const string& filename);
   FRIEND_TEST(GtfsParserTest, calendar_txt);
 
-  // Parses the GTFS trips file. Returns a map from trip_id to service_id.
-  map<string, string> parseTripsFile(const string& filename);
+  // Parses the GTFS trips file. Interns the trip ids anew, adds unknown
+  // service ids and returns the service of each trip.
+  vector<int> parseTripsFile(const string& filename);
   FRIEND_TEST(GtfsParserTest, trips_txt);
 
   // Parses the GTFS stops file.
   void parseStopsFile(const string& filename, TransitNetwork* network);
   FRIEND_TEST(GtfsParserTest, stops_txt);
 
-  // Parses the GTFS frequencies file.
+  // Parses the GTFS frequencies file. Frequencies of unknown trips and without
+  // runs are ignored.
   FrequencyMap parseFrequenciesFile(const string& filename);
   FRIEND_TEST(GtfsParserTest, frequencies_txt);
 
-  // Parses the GTFS stop-times file.
+  // Parses the GTFS stop-times file. The file is split into numChunks byte
+  // ranges which are parsed in parallel, by default about four per thread.
   vector<Trip> parseStopTimesFile(const string& filename,
-                                  const TransitNetwork& network);
+                                  const TransitNetwork& network,
+                                  int numChunks = 0);
   FRIEND_TEST(GtfsParserTest, stop_times_txt);
+  FRIEND_TEST(GtfsParserTest, stop_times_txt_chunks);
+
+  // Parses the trips starting in the byte range [begin, end) of the stop-times
+  // file. The last trip is read beyond end until it is complete.
+  void parseStopTimesChunk(const string& filename,
+                           const map<string, int>& field_map,
+                           const size_t begin, const size_t end,
+                           const TransitNetwork& network,
+                           vector<Trip>* trips) const;
 
   // Adds the data from one line of the stop-times file to a vector of stops.
-  void addStopToTrip(const string& arrTimeStr, const string& depTimeStr,
-                     const int stopIndex, Trip* trip);
+  void addStopToTrip(const CsvField& arrTime, const CsvField& depTime,
+                     const int stopIndex, Trip* trip) const;
+
+  // Converts a date of format "YYYYMMDD" into the number of days since
+  // 1970-01-01.
+  int gtfsDate2Day(const string& dateStr) const;
 
-  // Converts a string of format "" into the number of seconds from midnight.
+  // Converts a string of format "HH:MM:SS" into the number of seconds from
+  // midnight. Returns INT_MAX for strings without ':'.
   int gtfsTimeStr2Sec(const string& timesStr);
+  int gtfsTimeStr2Sec(const CsvField& time) const;
   FRIEND_TEST(GtfsParserTest, timeStringToSeconds);
 
   // Checks, whether two time stamps define a valid time period.
@@ -150,6 +245,8 @@ class GtfsParser {
 
   Data* _data;
   Logger* _log;
+  bool _periodic;
+  bool _expandFrequencies;
   friend class ScenarioGenerator;
 };
 
@@ -3,6 +3,7 @@
 #define SRC_GTFSPARSER_IMPL_H_
 
 #include "./GtfsParser.h"
+#include <cstdint>
 #include <map>
 #include <string>
 #include <vector>
@@ -12,6 +13,8 @@ struct GtfsParser::Frequency {
   Frequency() : start(-1), finish(-1), frequency(-1) {}
   Frequency(int start, int finish, int frequency)
   : start(start), finish(finish), frequency(frequency) {}
+  // Returns the number of runs starting before the finish time.
+  int numRuns() const { return (finish - start + frequency - 1) / frequency; }
   // starting time in seconds from 0:00:00
   int start;
   // finish time in seconds from 0:00:00
@@ -20,10 +23,30 @@ struct GtfsParser::Frequency {
   int frequency;
 };
 
+// A trip of stop_times.txt running on a certain day, with the index of its
+// first node in the network. In periodic networks a run stands for the trip on
+// all days of the time period.
+struct GtfsParser::TripRun {
+  TripRun(int trip, int timeOffset, size_t firstNode)
+  : trip(trip), timeOffset(timeOffset), firstNode(firstNode), days(0) {}
+  TripRun(int trip, int timeOffset, size_t firstNode, uint64_t days)
+  : trip(trip), timeOffset(timeOffset), firstNode(firstNode), days(days) {}
+  // index into the parsed trips
+  int trip;
+  // start of the day in seconds since 1970-01-01
+  int timeOffset;
+  size_t firstNode;
+  // the days from the start of the period the trip runs on, if periodic
+  uint64_t days;
+};
+
 // GtfsParser's internal stored data.
 struct GtfsParser::Data {
-  ActivityMap  lastServiceActivity;
-  map<string, string> lastTrip2Service;
+  IdMap lastServiceIds;
+  ServiceCalendar lastServiceCalendar;
+  IdMap lastTripIds;
+  // The interned service id of each interned trip id.
+  vector<int> lastTrip2Service;
   FrequencyMap lastFrequencies;
   vector<Trip> lastGtfsTrips;
 };
@@ -2,10 +2,65 @@
 #ifndef SRC_HUBSET_H_
 #define SRC_HUBSET_H_
 
-// #include <google/dense_hash_set>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
 #include <set>
+#include <utility>
+#include <vector>
 
-// typedef google::dense_hash_set<int> HubSet;
-typedef std::set<int> HubSet;
+// A set of hub stops. Keeps the hubs in order for iteration and a bitmap over
+// the stop indices for constant time membership tests during searches.
+class HubSet {
+ public:
+  typedef std::set<int>::const_iterator const_iterator;
+  typedef const_iterator iterator;
+  typedef int value_type;
+
+  HubSet() {}
+  HubSet(std::initializer_list<int> stops) {  // NOLINT
+    for (auto it = stops.begin(); it != stops.end(); ++it)
+      insert(*it);
+  }
+
+  // Adds a stop, returns its position and whether it was new.
+  std::pair<const_iterator, bool> insert(const int stop) {
+    assert(stop >= 0);
+    const uint32_t s = stop;
+    if (s / 64 >= _bits.size())
+      _bits.resize(s / 64 + 1, 0);
+    _bits[s / 64] |= static_cast<uint64_t>(1) << (s % 64);
+    return _stops.insert(stop);
+  }
+
+  // Returns whether the given stop is a hub.
+  bool contains(const int stop) const {
+    const uint32_t s = stop;
+    return s / 64 < _bits.size() && ((_bits[s / 64] >> (s % 64)) & 1);
+  }
+
+  const_iterator find(const int stop) const {
+    return contains(stop) ? _stops.find(stop) : _stops.end();
+  }
+
+  size_t size() const { return _stops.size(); }
+  bool empty() const { return _stops.empty(); }
+  const_iterator begin() const { return _stops.begin(); }
+  const_iterator end() const { return _stops.end(); }
+  const_iterator cbegin() const { return _stops.begin(); }
+  const_iterator cend() const { return _stops.end(); }
+
+  void clear() {
+    _stops.clear();
+    _bits.clear();
+  }
+
+  bool operator==(const HubSet& rhs) const { return _stops == rhs._stops; }
+
+ private:
+  std::set<int> _stops;
+  std::vector<uint64_t> _bits;
+};
 
 #endif  // SRC_HUBSET_H_
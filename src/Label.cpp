@@ -1,5 +1,8 @@
 // Copyright 2011: Eugen Sawin, Philip Stahl, Jonas Sternisko
 #include "./Label.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include <boost/foreach.hpp>
 #include <cassert>
 #include <string>
@@ -12,11 +15,44 @@ using std::swap;
 
 // LabelVec
 
+namespace {
+// Returns a mask with bit i set for each of the given costs with
+// costs[i] >= cost. The number of costs is a multiple of 4.
+inline uint32_t costsAtLeast(const int* costs, const size_t numCosts,
+                             const int cost) {
+  uint32_t mask = 0;
+#ifdef __SSE2__
+  const __m128i value = _mm_set1_epi32(cost);
+  for (size_t i = 0; i < numCosts; i += 4) {
+    const __m128i block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(costs + i));
+    const int below = _mm_movemask_ps(
+        _mm_castsi128_ps(_mm_cmplt_epi32(block, value)));
+    mask |= static_cast<uint32_t>(~below & 0xf) << i;
+  }
+#else
+  for (size_t i = 0; i < numCosts; ++i) {
+    mask |= static_cast<uint32_t>(costs[i] >= cost) << i;
+  }
+#endif
+  return mask;
+}
+
+// Returns the slots from the lowest set bit of range up to, but excluding,
+// the first used slot in range whose cost is below the given cost.
+inline uint32_t dominatedRun(const uint32_t range, const uint32_t used,
+                             const uint32_t atLeast) {
+  const uint32_t kept = range & used & ~atLeast;
+  return kept ? range & ((kept & -kept) - 1) : range;
+}
+}  // namespace
+
 LabelVec::LabelVec()
-  : _at(-1), _numUsed(0), _updated(true) {}
+  : _at(-1), _used(0) {}
 
 LabelVec::LabelVec(const int at, const unsigned char maxPenalty)
-  : _at(at), _numUsed(0), _updated(true) {
+  : _at(at), _used(0), _costs((maxPenalty + 4) & ~3, INT_MAX) {
+  assert(maxPenalty < kMaxFields);
   _fields.reserve(maxPenalty + 1);
   for (unsigned char i = 0; i <= maxPenalty; ++i) {
     _fields.push_back(Field(_at, i, maxPenalty / 2));
@@ -25,62 +61,29 @@ LabelVec::LabelVec(const int at, const unsigned char maxPenalty)
 }
 
 int LabelVec::pruneInactive() {
-  int pruned = 0;
-  for (auto it = _fields.begin(), end = _fields.end(); it != end; ++it) {
-    Field& field = *it;
-    if (field.used() && field.inactive()) {
-      ++pruned;
-      field.used(false);
-    }
+  uint32_t pruned = 0;
+  for (uint32_t used = _used; used; used &= used - 1) {
+    const int i = __builtin_ctz(used);
+    pruned |= static_cast<uint32_t>(_fields[i].inactive()) << i;
   }
-  _numUsed -= pruned;
-  _updated = true;
-  return pruned;
+  _used &= ~pruned;
+  return __builtin_popcount(pruned);
 }
 
 LabelVec::const_iterator LabelVec::begin() const {
-  if (_updated) {
-    _bakedLabels.clear();
-    _bakedLabels.reserve(_numUsed);
-    const unsigned char numFields = _fields.size();
-    for (unsigned char i = 0; i < numFields; ++i) {
-      const Field& field = _fields[i];
-      if (field.used()) {
-        _bakedLabels.push_back(Hnd(field.cost, i, field.inactive(),
-                                   const_cast<LabelVec::Field*>(&field)));
-      }
-    }
-    _updated = false;
-  }
-  return _bakedLabels.begin();
+  return const_iterator(this, 0);
 }
 
 LabelVec::const_iterator LabelVec::end() const {
-  if (_updated) {
-    _bakedLabels.clear();
-    _bakedLabels.reserve(_numUsed);
-    const unsigned char numFields = _fields.size();
-    for (unsigned char i = 0; i < numFields; ++i) {
-      const Field& field = _fields[i];
-      if (field.used()) {
-        _bakedLabels.push_back(Hnd(field.cost, i, field.inactive(),
-                                   const_cast<LabelVec::Field*>(&field)));
-      }
-    }
-    _updated = false;
-  }
-  return _bakedLabels.end();
+  return const_iterator(this, kMaxFields);
 }
 
-
 bool LabelVec::candidate(unsigned int cost, unsigned char penalty) const {
   assert(penalty < _fields.size());
-  int pos = penalty;
-  while (pos >= 0 && !_fields[pos].used()) {
-    --pos;
-  }
-//   const Field& field = _fields[pos];
-  return pos < 0 || cost < _fields[pos].cost;
+  // The used slots up to the given penalty, the last of them decides.
+  const uint32_t used = _used & (0xffffffffu >> (31 - penalty));
+  return !used || cost < static_cast<unsigned int>(
+      _costs[31 - __builtin_clz(used)]);
 }
 
 LabelVec::Field* LabelVec::add(const unsigned int cost,
@@ -90,19 +93,17 @@ LabelVec::Field* LabelVec::add(const unsigned int cost,
                                LabelVec::Field* parent) {
   assert(penalty < _fields.size());
   assert(_at >= 0);
-  _numUsed += !_fields[penalty].used();
-  // assert(_fields.at(penalty).at == _at);
+  assert(cost < INT_MAX);
   _fields[penalty] = Field(_at, penalty, maxPenalty, cost, walk, inactive,
                            parent);
   assert(_fields[penalty].at == _at);
-  size_t pos = penalty + 1;
-  while (pos < _fields.size() &&
-         (!_fields[pos].used() || cost <= _fields[pos].cost)) {
-    _numUsed -= _fields[pos].used();
-    _fields[pos].used(false);
-    ++pos;
-  }
-  _updated = true;
+  _costs[penalty] = cost;
+  // Drops the following labels up to the first one with lower cost.
+  const uint32_t higher = (0xfffffffeu << penalty) &
+                          (0xffffffffu >> (32 - _fields.size()));
+  _used &= ~dominatedRun(higher, _used,
+                         costsAtLeast(_costs.data(), _costs.size(), cost));
+  _used |= 1u << penalty;
   return &_fields[penalty];
 }
 
@@ -118,46 +119,42 @@ const LabelVec::Field& LabelVec::field(const unsigned char penalty) const {
   return _fields[penalty];
 }
 
+bool LabelVec::contains(const unsigned char penalty) const {
+  assert(penalty < _fields.size());
+  return (_used >> penalty) & 1;
+}
+
 void LabelVec::deactivate(const unsigned int cost,
                           const unsigned char penalty) {
   assert(penalty < _fields.size());
   assert(_at >= 0);
   assert(_fields[penalty].at == _at);
-
-  size_t pos = penalty;
-  const size_t numFields = _fields.size();
-  while (pos < numFields &&
-         (!_fields[pos].used() || cost <= _fields[pos].cost)) {
-    // Set inactive:
-    _fields[pos].inactive(true);
-    ++pos;
+  assert(cost < INT_MAX);
+
+  const uint32_t range = (0xffffffffu << penalty) &
+                         (0xffffffffu >> (32 - _fields.size()));
+  for (uint32_t run = dominatedRun(range, _used,
+           costsAtLeast(_costs.data(), _costs.size(), cost));
+       run; run &= run - 1) {
+    _fields[__builtin_ctz(run)].inactive(true);
   }
-  _updated = true;
 }
 
 
 int LabelVec::size() const {
-  return _numUsed;
+  return __builtin_popcount(_used);
 }
 
 int LabelVec::minCost() const {
   unsigned int m = INT_MAX;
-  for (auto it = _fields.begin(), end = _fields.end(); it != end; ++it) {
-    const Field& field = *it;
-    if (field.used()) {
-      m = min(m, field.cost);
-    }
+  for (uint32_t used = _used; used; used &= used - 1) {
+    m = min(m, static_cast<unsigned int>(_costs[__builtin_ctz(used)]));
   }
   return m;
 }
 
 int LabelVec::minPenalty() const {
-  size_t pen = 0;
-  const size_t numFields = _fields.size();
-  while (pen < numFields && !_fields[pen].used()) {
-    ++pen;
-  }
-  return pen < numFields ? pen : INT_MAX;
+  return _used ? __builtin_ctz(_used) : INT_MAX;
 }
 
 int LabelVec::at() const {
@@ -182,7 +179,7 @@ bool LabelMatrix::candidate(const int at, const unsigned int cost,
 
 bool LabelMatrix::contains(const int at, const unsigned char penalty) const {
   assert(at >= 0 && at < size());
-  return _matrix[at].field(penalty).used();
+  return _matrix[at].contains(penalty);
 }
 
 bool LabelMatrix::closed(const int at, const unsigned char penalty) const {
@@ -3,6 +3,7 @@
 #define SRC_LABEL_H_
 
 #include <boost/serialization/access.hpp>
+#include <stdint.h>
 #include <climits>
 #include <cassert>
 #include <set>
@@ -10,6 +11,7 @@
 #include <vector>
 #include <algorithm>
 #include <bitset>
+#include <iterator>
 
 using std::set;
 using std::string;
@@ -18,8 +20,14 @@ using std::bitset;
 using std::min;
 
 
+// The labels of a node, one slot per penalty. The costs and the set of used
+// slots are packed apart from the fields, so that the dominance checks are a
+// few vector compares and mask operations.
 class LabelVec {
  public:
+  // Maximum number of penalty slots, one bit each in the used mask.
+  static const int kMaxFields = 32;
+
   struct Field {
     Field(const int at, const unsigned char penalty,
           const unsigned char maxPenalty)
@@ -31,50 +39,49 @@ class LabelVec {
           const bool walk, const bool inactive, Field* parent)
       : at(at), penalty(penalty), maxPenalty(maxPenalty), cost(cost),
         parent(parent) {
-      used(true);
       this->walk(walk);
       this->inactive(inactive);
     }
 
-    bool used() const { return _misc.test(0); }
-    bool closed() const { return _misc.test(1); }
-    bool inactive() const { return _misc.test(2); }
-    bool walk() const { return _misc.test(3); }
+    bool closed() const { return _misc.test(0); }
+    bool inactive() const { return _misc.test(1); }
+    bool walk() const { return _misc.test(2); }
 
-    void used(bool value) { _misc.set(0, value); }
-    void closed(bool value) { _misc.set(1, value); }
-    void inactive(bool value) { _misc.set(2, value); }
-    void walk(bool value) { _misc.set(3, value); }
+    void closed(bool value) { _misc.set(0, value); }
+    void inactive(bool value) { _misc.set(1, value); }
+    void walk(bool value) { _misc.set(2, value); }
 
     int at;
     unsigned char penalty;
     unsigned char maxPenalty;
     unsigned int cost;
     Field* parent;
-    bitset<4> _misc;  // 0:used 1:closed 2:inactive 3:walk
+    bitset<3> _misc;  // 0:closed 1:inactive 2:walk
   };
 
   // A label proxy interfacing with the internal structures of  LabelVec.
   class Hnd {
    public:
+    // Orders by cost plus lower bound, then by penalty.
     struct Comp {
       bool operator()(const Hnd& lhs, const Hnd& rhs) const {
-        return rhs < lhs;
+        return rhs.key() < lhs.key();
       }
     };
 
     Hnd(const Hnd& rhs)
       : _values(rhs._values),
+        _bound(rhs._bound),
         _field(rhs._field),
         _inactive(rhs._inactive) {
       assert(at() == rhs.at());
     }
 
-    Hnd() : _values(0), _field(NULL), _inactive(false) {}
+    Hnd() : _values(0), _bound(0), _field(NULL), _inactive(false) {}
 
     Hnd(unsigned int cost, unsigned char penalty, bool inactive,
         LabelVec::Field* field)
-      : _values((cost << 8) | penalty), _field(field),
+      : _values((cost << 8) | penalty), _bound(0), _field(field),
         _inactive(inactive) {}
 
     Hnd& operator=(const Hnd& rhs) {
@@ -82,6 +89,7 @@ class LabelVec {
         return *this;
       }
       _values = rhs._values;
+      _bound = rhs._bound;
       _field = rhs._field;
       _inactive = rhs._inactive;
       return *this;
@@ -109,19 +117,86 @@ class LabelVec {
     bool closed() const { return _field->closed(); }
     bool inactive() const { return _inactive; }
     bool walk() const { return _field->walk(); }
+    // The lower bound of the cost to the target in goal-directed searches.
+    unsigned int bound() const { return _bound; }
 
     void inactive(bool value) { _inactive = value; }
+    void bound(unsigned int value) { _bound = value; }
     void closed(bool value) { _field->closed(value); }
 
     Field* field() const { return _field; }
 
    private:
+    uint64_t key() const {
+      return _values + (static_cast<uint64_t>(_bound) << 8);
+    }
+
     unsigned int _values;
+    unsigned int _bound;
     Field* _field;
     bool _inactive;
   };
 
-  typedef vector<Hnd>::const_iterator const_iterator;
+  // Walks the used fields in order of penalty. Keeps no state in the vector,
+  // so several threads may iterate over the same labels. Labels added or
+  // removed behind the current position are seen by the iteration.
+  class const_iterator {
+   public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef Hnd value_type;
+    typedef ptrdiff_t difference_type;
+    typedef const Hnd* pointer;
+    typedef const Hnd& reference;
+
+    const_iterator() : _vec(NULL), _pos(kMaxFields) {}
+
+    const_iterator(const LabelVec* vec, const int pos)
+      : _vec(vec), _pos(pos) {
+      if (pos < kMaxFields)
+        seek(0xffffffffu << pos);
+    }
+
+    const Hnd& operator*() const { return _label; }
+    const Hnd* operator->() const { return &_label; }
+
+    const_iterator& operator++() {
+      seek(0xfffffffeu << _pos);
+      return *this;
+    }
+
+    const_iterator operator++(int) {
+      const_iterator it = *this;
+      ++*this;
+      return it;
+    }
+
+    bool operator==(const const_iterator& rhs) const {
+      return _pos == rhs._pos;
+    }
+
+    bool operator!=(const const_iterator& rhs) const {
+      return _pos != rhs._pos;
+    }
+
+   private:
+    // Moves to the lowest used penalty within the given slots and sets the
+    // label proxy to its field.
+    void seek(const uint32_t slots) {
+      const uint32_t used = _vec->_used & slots;
+      if (!used) {
+        _pos = kMaxFields;
+        return;
+      }
+      _pos = __builtin_ctz(used);
+      const Field& field = _vec->_fields[_pos];
+      _label = Hnd(field.cost, _pos, field.inactive(),
+                   const_cast<Field*>(&field));
+    }
+
+    const LabelVec* _vec;
+    int _pos;
+    Hnd _label;
+  };
 
   LabelVec();
   LabelVec(const int at, const unsigned char maxPenalty);
@@ -143,6 +218,9 @@ class LabelVec {
   // Returns const reference to the field at given penalty.
   const Field& field(const unsigned char penalty) const;
 
+  // Returns whether there is a label with given penalty.
+  bool contains(const unsigned char penalty) const;
+
   // Removes all inactive labels.
   int pruneInactive();
 
@@ -164,10 +242,10 @@ class LabelVec {
 
  private:
   int _at;
-  int _numUsed;
+  uint32_t _used;
   vector<Field> _fields;
-  mutable bool _updated;
-  mutable vector<Hnd> _bakedLabels;
+  // The costs per penalty, padded to whole SSE registers.
+  vector<int> _costs;
 };
 
 // Holds a label vector for each node and ways to operate on them.
@@ -0,0 +1,126 @@
+// Copyright 2012: Eugen Sawin, Philip Stahl, Jonas Sternisko
+#include "./Landmarks.h"
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <functional>
+#include <queue>
+#include <utility>
+#include <vector>
+#include "./TransitNetwork.h"
+
+using std::max;
+using std::pair;
+using std::make_pair;
+using std::priority_queue;
+using std::greater;
+
+const int Landmarks::INFINITE = INT_MAX;
+
+Landmarks::Landmarks() : _slack(0) {}
+
+void Landmarks::init(const TransitNetwork& compressed, const int numLandmarks,
+                     const int slack) {
+  _stops.clear();
+  _costs.clear();
+  _slack = slack;
+  const int numStops = compressed.numStops();
+  if (numStops == 0 || numLandmarks <= 0)
+    return;
+  // The stop graph and its reverse.
+  vector<vector<pair<int, int> > > graph(numStops);
+  vector<vector<pair<int, int> > > reverse(numStops);
+  for (size_t node = 0; node < compressed.numNodes(); ++node) {
+    const int stop = compressed.nodeStop(node);
+    const vector<Arc>& arcs = compressed.adjacencyList(node);
+    for (auto arc = arcs.begin(); arc != arcs.end(); ++arc) {
+      const int destStop = compressed.nodeStop(arc->destination());
+      graph[stop].push_back(make_pair(destStop, arc->cost()));
+      reverse[destStop].push_back(make_pair(stop, arc->cost()));
+    }
+  }
+
+  // Farthest-point selection: each landmark is the stop farthest from the
+  // landmarks before, starting from the stop farthest from stop 0. Stops not
+  // reached yet are the farthest.
+  vector<vector<int> > from, to;
+  vector<int> distance = costs(graph, 0);
+  while (static_cast<int>(_stops.size()) < numLandmarks) {
+    const int landmark = std::max_element(distance.begin(), distance.end()) -
+                         distance.begin();
+    if (distance[landmark] == 0)
+      break;
+    _stops.push_back(landmark);
+    from.push_back(costs(graph, landmark));
+    to.push_back(costs(reverse, landmark));
+    if (_stops.size() == 1)
+      distance.assign(numStops, INFINITE);
+    for (int stop = 0; stop < numStops; ++stop)
+      distance[stop] = std::min(distance[stop], from.back()[stop]);
+  }
+
+  const int numSelected = _stops.size();
+  _costs.resize(static_cast<size_t>(numStops) * numSelected * 2);
+  for (int stop = 0; stop < numStops; ++stop) {
+    for (int i = 0; i < numSelected; ++i) {
+      _costs[(stop * numSelected + i) * 2] = from[i][stop];
+      _costs[(stop * numSelected + i) * 2 + 1] = to[i][stop];
+    }
+  }
+}
+
+int Landmarks::lowerBound(const int stop, const int destStop) const {
+  if (stop == destStop || _stops.empty())
+    return 0;
+  const int numSelected = _stops.size();
+  const int* s = &_costs[stop * numSelected * 2];
+  const int* t = &_costs[destStop * numSelected * 2];
+  int bound = 0;
+  for (int i = 0; i < 2 * numSelected; i += 2) {
+    // A stop reached from the landmark reaches all stops reachable from it,
+    // a stop reaching the landmark is reached by all stops reaching it.
+    if (s[i] != INFINITE) {
+      if (t[i] == INFINITE)
+        return INFINITE;
+      bound = max(bound, t[i] - s[i]);
+    }
+    if (t[i + 1] != INFINITE) {
+      if (s[i + 1] == INFINITE)
+        return INFINITE;
+      bound = max(bound, s[i + 1] - t[i + 1]);
+    }
+  }
+  return max(0, bound - _slack);
+}
+
+const vector<int>& Landmarks::stops() const {
+  return _stops;
+}
+
+size_t Landmarks::size() const {
+  return _stops.size();
+}
+
+vector<int> Landmarks::costs(const vector<vector<pair<int, int> > >& graph,
+                             const int stop) {
+  vector<int> costs(graph.size(), INFINITE);
+  priority_queue<pair<int, int>, vector<pair<int, int> >,
+                 greater<pair<int, int> > > queue;
+  costs[stop] = 0;
+  queue.push(make_pair(0, stop));
+  while (!queue.empty()) {
+    const pair<int, int> top = queue.top();
+    queue.pop();
+    if (top.first > costs[top.second])
+      continue;
+    const vector<pair<int, int> >& arcs = graph[top.second];
+    for (auto arc = arcs.begin(); arc != arcs.end(); ++arc) {
+      const int cost = top.first + arc->second;
+      if (cost < costs[arc->first]) {
+        costs[arc->first] = cost;
+        queue.push(make_pair(cost, arc->first));
+      }
+    }
+  }
+  return costs;
+}
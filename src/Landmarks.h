@@ -0,0 +1,54 @@
+// Copyright 2012: Eugen Sawin, Philip Stahl, Jonas Sternisko
+#ifndef SRC_LANDMARKS_H_
+#define SRC_LANDMARKS_H_
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+using std::vector;
+
+class TransitNetwork;
+
+// Lower bounds of the travel costs between stops from the costs to and from a
+// few landmark stops, for goal-directed searches (ALT). The costs are computed
+// on the time-compressed network, whose arcs are the lowest costs between two
+// stops. By the triangle inequality, cost(s, t) >= cost(L, t) - cost(L, s) and
+// cost(s, t) >= cost(s, L) - cost(t, L) for each landmark L.
+class Landmarks {
+ public:
+  // Used for the costs of unreachable stops.
+  static const int INFINITE;
+
+  Landmarks();
+
+  // Selects the landmarks among the stops of the time-compressed network by
+  // farthest-point selection and computes the costs to and from them. The
+  // bounds are lowered by the slack, for walks shorter than the transfer
+  // buffer, which the compressed network rounds up.
+  void init(const TransitNetwork& compressed, const int numLandmarks,
+            const int slack);
+
+  // Returns a lower bound of the cost from the stop to the destination stop,
+  // INFINITE if the destination is not reachable.
+  int lowerBound(const int stop, const int destStop) const;
+
+  // Returns the landmark stops in order of selection.
+  const vector<int>& stops() const;
+
+  // Returns the number of landmarks.
+  size_t size() const;
+
+ private:
+  // Returns the costs from the stop to all stops of the network given by its
+  // adjacency lists, INFINITE for the unreachable ones.
+  static vector<int> costs(const vector<vector<std::pair<int, int> > >& graph,
+                           const int stop);
+
+  vector<int> _stops;
+  // For each stop and landmark the cost from and the cost to the landmark.
+  vector<int> _costs;
+  int _slack;
+};
+
+#endif  // SRC_LANDMARKS_H_
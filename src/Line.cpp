@@ -1,5 +1,6 @@
 // Copyright 2011: Eugen Sawin, Philip Stahl, Jonas Sternisko
 #include "./Line.h"
+#include <algorithm>
 #include <cassert>
 #include <climits>
 #include <set>
@@ -8,6 +9,7 @@
 #include "./Utilities.h"
 
 using std::make_pair;
+using std::min;
 
 // TripTime
 
@@ -55,13 +57,63 @@ string TripTime::str() const {
   return s;
 }
 
+// FrequencyTime
+
+FrequencyTime::FrequencyTime() : _headway(0), _numRuns(0) {}
+
+FrequencyTime::FrequencyTime(const TripTime& time, const int headway,
+                             const int numRuns)
+    : _time(time), _headway(headway), _numRuns(numRuns) {
+  assert(headway > 0 && numRuns > 0);
+}
+
+bool FrequencyTime::operator==(const FrequencyTime& rhs) const {
+  return _time == rhs._time && _headway == rhs._headway &&
+         _numRuns == rhs._numRuns;
+}
+
+int FrequencyTime::nextRun(const int pos, const int64_t time) const {
+  const int64_t first = _time.dep(pos);
+  if (time <= first)
+    return 0;
+  return min<int64_t>(_numRuns, (time - first + _headway - 1) / _headway);
+}
+
+int64_t FrequencyTime::arr(const int run, const int pos) const {
+  assert(run >= 0 && run < _numRuns);
+  return _time.arr(pos) + static_cast<int64_t>(run) * _headway;
+}
+
+int64_t FrequencyTime::dep(const int run, const int pos) const {
+  assert(run >= 0 && run < _numRuns);
+  return _time.dep(pos) + static_cast<int64_t>(run) * _headway;
+}
+
+int FrequencyTime::numRuns() const {
+  return _numRuns;
+}
+
+int FrequencyTime::headway() const {
+  return _headway;
+}
+
+string FrequencyTime::str() const {
+  return _time.str() + " every " + convert<string>(_headway) + "s x " +
+         convert<string>(_numRuns);
+}
+
 // Trip
 
-Trip::Trip() {
+Trip::Trip() : _index(-1), _headway(0), _numRuns(1) {
   _id = "undefined";
 }
 
-Trip::Trip(const string& id) {
+Trip::Trip(const string& id) : _index(-1), _headway(0), _numRuns(1) {
+  _id = id;
+}
+
+Trip::Trip(const string& id, const int index)
+    : _index(index), _headway(0), _numRuns(1) {
   _id = id;
 }
 
@@ -69,8 +121,27 @@ const string& Trip::id() const {
   return _id;
 }
 
+int Trip::index() const {
+  return _index;
+}
+
+void Trip::frequency(const int headway, const int numRuns) {
+  assert(headway > 0 && numRuns > 0);
+  _headway = headway;
+  _numRuns = numRuns;
+}
+
+int Trip::headway() const {
+  return _headway;
+}
+
+int Trip::numRuns() const {
+  return _numRuns;
+}
+
 bool Trip::operator==(const Trip& rhs) const {
-  return _time == rhs._time && _stops == rhs._stops && _id == rhs._id;
+  return _time == rhs._time && _stops == rhs._stops && _id == rhs._id &&
+         _headway == rhs._headway && _numRuns == rhs._numRuns;
 }
 
 int Trip::size() const {
@@ -149,7 +220,11 @@ bool Line::addTrip(const Trip& trip) {
     if (_stops.empty()) {
       _stops = trip.stops();
     }
-    _tripTimes.insert(trip.time());
+    if (trip.headway())
+      _frequencies.push_back(FrequencyTime(trip.time(), trip.headway(),
+                                           trip.numRuns()));
+    else
+      _tripTimes.insert(trip.time());
     return true;
   }
   return false;
@@ -164,28 +239,47 @@ int Line::stop(const int pos) const {
 }
 
 int Line::cost(const int depPos, const int64_t time, const int destPos) const {
-  // This might be handled more efficiently with d&c.
-  auto it = _tripTimes.begin();
-  while (it != _tripTimes.end() && it->dep(depPos) < time) {
-    ++it;
-  }
-  if (it == _tripTimes.end()) {
+  int64_t depTime, arrTime;
+  if (!next(depPos, time, destPos, &depTime, &arrTime)) {
     return INFINITE;
   }
-  return it->arr(destPos) - time;
+  return arrTime - time;
 }
 
 
 int Line::nextDeparture(const int depPos, const int64_t time,
                         const int destPos) const {
+  int64_t depTime, arrTime;
+  if (!next(depPos, time, destPos, &depTime, &arrTime)) {
+    return INFINITE;
+  }
+  return depTime;
+}
+
+
+bool Line::next(const int depPos, const int64_t time, const int destPos,
+                int64_t* depTime, int64_t* arrTime) const {
+  bool found = false;
+  // This might be handled more efficiently with d&c.
   auto it = _tripTimes.begin();
   while (it != _tripTimes.end() && it->dep(depPos) < time) {
     ++it;
   }
-  if (it == _tripTimes.end()) {
-    return INFINITE;
+  if (it != _tripTimes.end()) {
+    *depTime = it->dep(depPos);
+    *arrTime = it->arr(destPos);
+    found = true;
   }
-  return it->dep(depPos);
+  // The next run of each frequency follows from its headway.
+  for (auto f = _frequencies.begin(); f != _frequencies.end(); ++f) {
+    const int run = f->nextRun(depPos, time);
+    if (run < f->numRuns() && (!found || f->arr(run, destPos) < *arrTime)) {
+      *depTime = f->dep(run, depPos);
+      *arrTime = f->arr(run, destPos);
+      found = true;
+    }
+  }
+  return found;
 }
 
 
@@ -200,6 +294,9 @@ string Line::str() const {
     const TripTime& t = *it;
     s += t.str() + "\n";
   }
+  for (auto it = _frequencies.begin(); it != _frequencies.end(); ++it) {
+    s += it->str() + "\n";
+  }
   return s;
 }
 
@@ -5,6 +5,8 @@
 #include <boost/serialization/access.hpp>
 #include <boost/serialization/set.hpp>
 #include <boost/serialization/utility.hpp>
+#include <boost/serialization/vector.hpp>
+#include <boost/serialization/version.hpp>
 #include <set>
 #include <string>
 #include <vector>
@@ -54,12 +56,56 @@ class TripTime {
   friend class boost::serialization::access;
 };
 
+// Time table for the runs of a trip at a regular headway. The first run has
+// the given time table, the following runs repeat it every headway seconds.
+class FrequencyTime {
+ public:
+  FrequencyTime();
+  FrequencyTime(const TripTime& time, const int headway, const int numRuns);
+
+  bool operator==(const FrequencyTime& rhs) const;
+
+  // Returns the first run departing at given stop position not before time,
+  // numRuns() if there is none.
+  int nextRun(const int pos, const int64_t time) const;
+
+  // Returns the arrival time of the run at given stop position.
+  int64_t arr(const int run, const int pos) const;
+
+  // Returns the departure time of the run at given stop position.
+  int64_t dep(const int run, const int pos) const;
+
+  // Returns the number of runs.
+  int numRuns() const;
+
+  // Returns the seconds between two runs.
+  int headway() const;
+
+  // Returns a string representation of the time table.
+  string str() const;
+
+ private:
+  TripTime _time;
+  int _headway;
+  int _numRuns;
+
+  template<class Archive>
+  void serialize(Archive& ar, const unsigned int version) {  // NOLINT
+    ar & _time;
+    ar & _headway;
+    ar & _numRuns;
+  }
+  friend class boost::serialization::access;
+};
+
 // A trip is a sequence of stops without transfers.
 // It consists of a time table with corresponding stop indices.
 class Trip {
  public:
   explicit Trip();
   explicit Trip(const string& id);
+  // Constructs a trip with the GTFS id interned to index by the parser.
+  Trip(const string& id, const int index);
 
   bool operator==(const Trip& rhs) const;
 
@@ -84,11 +130,26 @@ class Trip {
   // Returns a const reference to the trip id.
   const string& id() const;
 
+  // Returns the interned trip id or -1 if the trip has none.
+  int index() const;
+
+  // Makes the trip the first of numRuns runs at the given headway.
+  void frequency(const int headway, const int numRuns);
+
+  // Returns the seconds between two runs of the trip, 0 for a single run.
+  int headway() const;
+
+  // Returns the number of runs of the trip.
+  int numRuns() const;
+
   // Returns a string representation of the trip.
   string str() const;
 
  private:
   string _id;
+  int _index;
+  int _headway;
+  int _numRuns;
   TripTime _time;
   // stop indices
   vector<int> _stops;
@@ -126,17 +187,28 @@ class Line {
   string str() const;
 
  private:
+  // Finds the first arrival at dest of the runs departing at dep not before
+  // time. Returns false if there is none.
+  bool next(const int depPos, const int64_t time, const int destPos,
+            int64_t* depTime, int64_t* arrTime) const;
+
   set<TripTime> _tripTimes;
+  // Trips with a headway, kept once for all their runs.
+  vector<FrequencyTime> _frequencies;
   vector<int> _stops;
 
   template<class Archive>
   void serialize(Archive& ar, const unsigned int version) {  // NOLINT
     ar & _tripTimes;
     ar & _stops;
+    if (version > 0)
+      ar & _frequencies;
   }
   friend class boost::serialization::access;
 };
 
+BOOST_CLASS_VERSION(Line, 1)
+
 // Utilities for trips and line construction.
 struct LineFactory {
   // Creates trips out of a list of times with corresponding stop indices, adds
@@ -1,41 +1,335 @@
 // Copyright 2011: Eugen Sawin, Philip Stahl, Jonas Sternisko
 #include "./Logger.h"
+#include <boost/thread.hpp>
+#include <boost/thread/tss.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <algorithm>
+#include <atomic>
 #include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
 #include <string>
+#include <vector>
 #include "./Utilities.h"
 #include "./Clock.h"
 
 using std::cout;
-using boost::posix_time::ptime;
-using boost::posix_time::second_clock;
+using std::vector;
 using base::Clock;
 
 typedef boost::unique_lock<boost::shared_mutex> WriteLock;
 typedef boost::shared_lock<boost::shared_mutex> ReadLock;
 
 const size_t Logger::BUFFER_SIZE = 512;
+const int Logger::kFlushIntervalMs = 500;
 
-Logger::Logger()
-    : path_(""), _stream(NULL), timer_counter_(0) , enabled_(true) {
-  target("");
+namespace {
+// Maximum size of a formatted record: tag, timestamp, message and newline.
+const size_t kRecordSize = 576;
+// Number of records in the ring buffer of each logging thread.
+const size_t kRingSize = 256;
+// Sleep time of the background writer when there is nothing to write.
+const int kIdleSleepMs = 2;
+
+// Returns a monotonic timestamp in milliseconds.
+int64_t nowMs() {
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec * 1000 + t.tv_nsec / 1000000;
 }
 
-Logger::Logger(const Logger& other)
-    : path_(""), _stream(NULL), timers_(other.timers_),
-      timer_counter_(other.timer_counter_), enabled_(other.enabled_) {
-  target(other.path_);
+// Writes "[tag@YYYY-Mon-DD hh:mm:ss] " to buffer and returns its length. The
+// timestamp string is cached per thread and reformatted once per second.
+size_t formatPrefix(const char* tag, char* buffer, size_t size) {
+  static __thread time_t cachedSecond = -1;
+  static __thread char cachedStamp[32];
+  const time_t second = time(NULL);
+  if (second != cachedSecond) {
+    tm local;
+    localtime_r(&second, &local);
+    strftime(cachedStamp, sizeof(cachedStamp), "%Y-%b-%d %H:%M:%S", &local);
+    cachedSecond = second;
+  }
+  const int length = snprintf(buffer, size, "[%s@%s] ", tag, cachedStamp);
+  return std::min(static_cast<size_t>(length), size - 1);
 }
+}  // namespace
+
+// The output stream of a logger. It is shared by all copies of the logger and
+// by the records which are still waiting to be written.
+struct LogTarget {
+  explicit LogTarget(const string& path)
+      : path(path), stream(&cout), dirty(false), urgent(false),
+        lastFlush(nowMs()) {
+    if (path != "") {
+      ofstream* file = new ofstream(path.c_str(), std::ios::app);
+      if (file->is_open()) {
+        stream = file;
+      } else {
+        delete file;
+        this->path = "";
+      }
+    }
+  }
+
+  ~LogTarget() {
+    stream->flush();
+    if (path != "") {
+      delete stream;
+    }
+  }
+
+  // Appends the text to the stream, flushing it if requested. An urgent text
+  // is flushed by the next call to flush.
+  void write(const char* text, const size_t length, const bool flushNow,
+             const bool urgentText) {
+    boost::mutex::scoped_lock lock(mutex);
+    stream->write(text, length);
+    if (flushNow) {
+      stream->flush();
+      dirty = false;
+      urgent = false;
+    } else {
+      dirty = true;
+      urgent = urgent || urgentText;
+    }
+  }
+
+  // Flushes the stream if it is dirty and either forced, marked urgent or the
+  // flush interval has passed. Returns whether the stream is clean afterwards.
+  bool flush(const bool force, const int64_t now) {
+    boost::mutex::scoped_lock lock(mutex);
+    if (dirty && (force || urgent ||
+                  now - lastFlush >= Logger::kFlushIntervalMs)) {
+      stream->flush();
+      dirty = false;
+      urgent = false;
+      lastFlush = now;
+    }
+    return !dirty;
+  }
+
+  string path;
+  ostream* stream;
+  boost::mutex mutex;
+  bool dirty;
+  bool urgent;
+  int64_t lastFlush;
+};
 
-Logger::~Logger() {
-  reset();
+namespace {
+// Returns the target shared by all loggers writing to stdout.
+const boost::shared_ptr<LogTarget>& stdoutTarget() {
+  static const boost::shared_ptr<LogTarget> target(new LogTarget(""));
+  return target;
 }
 
+// A formatted message waiting to be written.
+struct LogRecord {
+  boost::shared_ptr<LogTarget> target;
+  size_t length;
+  bool urgent;
+  char text[kRecordSize];
+};
+
+// A bounded single-producer single-consumer queue of log records. The
+// producer is the owning thread, the consumer whoever holds the drain lock of
+// the LogWriter.
+class LogRing {
+ public:
+  LogRing() : _head(0), _tail(0), _orphaned(false) {}
+
+  // Returns the next free record or NULL if the ring is full.
+  LogRecord* reserve() {
+    const size_t head = _head.load(std::memory_order_relaxed);
+    if (head - _tail.load(std::memory_order_acquire) == kRingSize) {
+      return NULL;
+    }
+    return &_records[head % kRingSize];
+  }
+
+  // Publishes the record returned by the last call to reserve.
+  void commit() {
+    _head.store(_head.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+  }
+
+  // Returns the oldest published record or NULL if the ring is empty.
+  LogRecord* front() {
+    const size_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail == _head.load(std::memory_order_acquire)) {
+      return NULL;
+    }
+    return &_records[tail % kRingSize];
+  }
+
+  // Releases the record returned by front.
+  void pop() {
+    _tail.store(_tail.load(std::memory_order_relaxed) + 1,
+                std::memory_order_release);
+  }
+
+  // Marks the ring as abandoned by its thread.
+  void orphan() { _orphaned.store(true, std::memory_order_release); }
+  bool orphaned() const { return _orphaned.load(std::memory_order_acquire); }
+
+ private:
+  LogRecord _records[kRingSize];
+  std::atomic<size_t> _head;
+  std::atomic<size_t> _tail;
+  std::atomic<bool> _orphaned;
+};
+
+// Owns the ring buffers of all logging threads and the background thread
+// which writes their records.
+class LogWriter {
+ public:
+  // Returns the process-wide writer, starting it on first use.
+  static LogWriter& instance() {
+    // Never destroyed, records may be logged during static destruction.
+    static LogWriter* writer = new LogWriter();
+    return *writer;
+  }
+
+  // Returns the ring buffer of the calling thread or NULL if the writer has
+  // been shut down.
+  LogRing* localRing() {
+    if (!_running.load(std::memory_order_acquire)) {
+      return NULL;
+    }
+    LogRing* ring = _localRing.get();
+    if (!ring) {
+      ring = new LogRing();
+      boost::mutex::scoped_lock lock(_registryMutex);
+      _rings.push_back(ring);
+      _localRing.reset(ring);
+    }
+    return ring;
+  }
+
+  // Counts a dropped record.
+  void drop() { _dropped.fetch_add(1, std::memory_order_relaxed); }
+
+  // Returns the number of dropped records.
+  uint64_t numDropped() const {
+    return _dropped.load(std::memory_order_relaxed);
+  }
+
+  // Writes the records of all rings and flushes the targets according to
+  // their policy or unconditionally if force is set. The registry is only
+  // locked to take the list of rings, so threads registering their ring do
+  // not wait for the output streams.
+  // Returns the number of records written.
+  size_t drain(const bool force) {
+    boost::mutex::scoped_lock drainLock(_drainMutex);
+    {
+      boost::mutex::scoped_lock lock(_registryMutex);
+      _draining = _rings;
+    }
+    size_t numWritten = 0;
+    vector<LogRing*> drained;
+    for (size_t i = 0; i < _draining.size(); ++i) {
+      LogRing* ring = _draining[i];
+      // Check before draining, an orphan does not receive new records.
+      const bool orphaned = ring->orphaned();
+      for (LogRecord* rec = ring->front(); rec; rec = ring->front()) {
+        rec->target->write(rec->text, rec->length, false, rec->urgent);
+        if (std::find(_dirty.begin(), _dirty.end(), rec->target) ==
+            _dirty.end()) {
+          _dirty.push_back(rec->target);
+        }
+        rec->target.reset();
+        ring->pop();
+        ++numWritten;
+      }
+      if (orphaned) {
+        drained.push_back(ring);
+      }
+    }
+    if (!drained.empty()) {
+      // Rings are only removed here, under the drain lock, so the orphans are
+      // still registered.
+      boost::mutex::scoped_lock lock(_registryMutex);
+      for (size_t i = 0; i < drained.size(); ++i) {
+        _rings.erase(std::find(_rings.begin(), _rings.end(), drained[i]));
+        delete drained[i];
+      }
+    }
+    const int64_t now = nowMs();
+    for (size_t i = 0; i < _dirty.size();) {
+      if (_dirty[i]->flush(force, now)) {
+        _dirty[i] = _dirty.back();
+        _dirty.pop_back();
+      } else {
+        ++i;
+      }
+    }
+    return numWritten;
+  }
+
+ private:
+  LogWriter() : _localRing(&LogWriter::releaseRing), _running(true),
+                _dropped(0) {
+    _thread = boost::thread(&LogWriter::run, this);
+    atexit(&LogWriter::shutdown);
+  }
+
+  // The background loop.
+  void run() {
+    while (_running.load(std::memory_order_acquire)) {
+      if (drain(false) == 0) {
+        boost::this_thread::sleep(
+            boost::posix_time::milliseconds(kIdleSleepMs));
+      }
+    }
+  }
+
+  // Called on thread exit, the writer deletes the ring once it is drained.
+  static void releaseRing(LogRing* ring) {
+    ring->orphan();
+  }
+
+  // Stops the background thread and writes the remaining records. Messages
+  // logged afterwards are written synchronously.
+  static void shutdown() {
+    LogWriter& writer = instance();
+    writer._running.store(false, std::memory_order_release);
+    writer._thread.join();
+    writer.drain(true);
+  }
+
+  boost::mutex _registryMutex;
+  boost::mutex _drainMutex;
+  vector<LogRing*> _rings;
+  // The rings taken by the current drain, kept to reuse the storage.
+  vector<LogRing*> _draining;
+  vector<boost::shared_ptr<LogTarget> > _dirty;
+  boost::thread_specific_ptr<LogRing> _localRing;
+  std::atomic<bool> _running;
+  std::atomic<uint64_t> _dropped;
+  boost::thread _thread;
+};
+}  // namespace
+
+Logger::Logger()
+    : _target(stdoutTarget()), _flushPolicy(kFlushBatch), timer_counter_(0),
+      enabled_(true) {}
+
+Logger::Logger(const Logger& other)
+    : _target(other._target), _flushPolicy(other._flushPolicy),
+      timers_(other.timers_), timer_counter_(other.timer_counter_),
+      enabled_(other.enabled_) {}
+
+Logger::~Logger() {}
+
 Logger& Logger::operator=(const Logger& other) {
+  _target = other._target;
+  _flushPolicy = other._flushPolicy;
   timers_ = other.timers_;
   timer_counter_ = other.timer_counter_;
   enabled_ = other.enabled_;
-  target(other.path_);
   return *this;
 }
 
@@ -48,26 +342,36 @@ void Logger::enabled(const bool state) {
 }
 
 void Logger::reset() {
-  if (path_ != "") {
-    static_cast<ofstream*>(_stream)->close();
-    delete _stream;
-  }
+  _target = stdoutTarget();
 }
 
 void Logger::target(const string& path) {
-  reset();
-  path_ = path;
-  if (path_ == "") {
-    _stream = &cout;
-  } else {
-    _stream = new ofstream(path_.c_str(), std::ios::app);
-    if (!static_cast<ofstream*>(_stream)->is_open()) {
-      target("");
-      error("unable to open " + path + " for logging");
-    }
+  if (path == "") {
+    reset();
+    return;
+  }
+  _target.reset(new LogTarget(path));
+  if (_target->path == "") {
+    error("unable to open " + path + " for logging");
   }
 }
 
+Logger::FlushPolicy Logger::flushPolicy() const {
+  return _flushPolicy;
+}
+
+void Logger::flushPolicy(const FlushPolicy policy) {
+  _flushPolicy = policy;
+}
+
+void Logger::flush() const {
+  LogWriter::instance().drain(true);
+}
+
+uint64_t Logger::numDropped() {
+  return LogWriter::instance().numDropped();
+}
+
 string Logger::shorten(const string& text) const {
   string tex;
   if (text.size() > maxMessageLength()) {
@@ -78,25 +382,59 @@ string Logger::shorten(const string& text) const {
   return tex;
 }
 
+void Logger::write(const char* tag, const char* format, va_list args) const {
+  LogRing* ring = NULL;
+  if (_flushPolicy != kFlushAlways) {
+    ring = LogWriter::instance().localRing();
+  }
+  const bool isError = strcmp(tag, "error") == 0;
+  LogRecord* rec = ring ? ring->reserve() : NULL;
+  if (ring && !rec && !isError) {
+    LogWriter::instance().drop();
+    return;
+  }
+  char buffer[kRecordSize];
+  char* text = rec ? rec->text : buffer;
+  size_t length = formatPrefix(tag, text, kRecordSize);
+  const int messageLength = vsnprintf(text + length, BUFFER_SIZE, format,
+                                      args);
+  length += std::min(static_cast<size_t>(std::max(messageLength, 0)),
+                     BUFFER_SIZE - 1);
+  text[length++] = '\n';
+  if (rec) {
+    rec->length = length;
+    rec->urgent = isError || _flushPolicy == kFlushBatch;
+    rec->target = _target;
+    ring->commit();
+  } else {
+    // Synchronous write: requested by policy, after shutdown or for errors
+    // which do not fit into the ring.
+    _target->write(text, length, true, isError);
+  }
+}
+
+void Logger::write(const char* tag, const char* format, ...) const {
+  va_list args;
+  va_start(args, format);
+  write(tag, format, args);
+  va_end(args);
+}
+
 void Logger::debug(const char* format, ...) const {
 #ifndef NDEBUG
   if (!enabled()) {
     return;
   }
-  char buffer[BUFFER_SIZE];  // TODO(sawine): unsafe, what about longer strings?
   va_list args;
   va_start(args, format);
-  vsprintf(buffer, format, args);
+  write("debug", format, args);
   va_end(args);
-  ptime now = second_clock::local_time();
-  *_stream << "[debug@" << now << "] " << buffer << "\n";
-  _stream->flush();
 #endif
 }
 
 void Logger::debug(const string& text) const {
 #ifndef NDEBUG
-  debug(shorten(text).c_str());
+  debug("%s", shorten(text).c_str());
 #endif
 }
 
@@ -104,44 +442,32 @@ void Logger::info(const char* format, ...) const {
   if (!enabled()) {
     return;
   }
-  char buffer[BUFFER_SIZE];
   va_list args;
   va_start(args, format);
-  vsprintf(buffer, format, args);
+  write(" info", format, args);
   va_end(args);
-  ptime now = second_clock::local_time();
-  // *_stream << BROWN << "[ info@" << now << "] " << buffer << RESET << "\n";
-  *_stream << "[ info@" << now << "] " << buffer << "\n";
-  _stream->flush();
 }
 
 void Logger::info(const string& text) const {
-  string shortened = shorten(text);
-  info(shortened.c_str());
+  info("%s", shorten(text).c_str());
 }
 
 void Logger::error(const char* format, ...) const {
   if (!enabled()) {
     return;
   }
-  char buffer[BUFFER_SIZE];
   va_list args;
   va_start(args, format);
-  vsprintf(buffer, format, args);
+  write("error", format, args);
   va_end(args);
-  ptime now = second_clock::local_time();
-  // *_stream << RED << BOLD << "[error@" << now << "] "
-  // << buffer << RESET <<"\n";
-  *_stream << "[error@" << now << "] " << buffer << "\n";
-  _stream->flush();
 }
 
 void Logger::error(const string& text) const {
-  error(shorten(text).c_str());
+  error("%s", shorten(text).c_str());
 }
 
 int Logger::beginPerf() {
-  WriteLock(_mutex);
+  WriteLock lock(_mutex);
   const int id = timer_counter_++;
   timers_[id] = Clock();
   return id;
@@ -150,25 +476,20 @@ int Logger::beginPerf() {
 double Logger::endPerf(const int id, const string& text, const int iter) {
   double t = 0.0;
   {
-    ReadLock(_mutex);
+    WriteLock lock(_mutex);
     t = (Clock() - timers_[id]) * Clock::kSecInMicro;
-  }
-  {
-    WriteLock(_mutex);
     timers_.erase(id);
   }
   if (!enabled()) {
     return t;
   }
   if (text != "") {
-    ptime now = second_clock::local_time();
-    *_stream << "[ perf@" << now << "] ["
-            << formatPerfTime(t);
     if (iter > 1) {
-      *_stream << " | " << formatPerfTime(t / iter);
+      write(" perf", "[%s | %s] %s", formatPerfTime(t).c_str(),
+            formatPerfTime(t / iter).c_str(), text.c_str());
+    } else {
+      write(" perf", "[%s] %s", formatPerfTime(t).c_str(), text.c_str());
     }
-    *_stream << "] " << text << "\n";
-    _stream->flush();
   }
   return t;
 }
@@ -179,22 +500,17 @@ int Logger::beginProg() {
 
 double Logger::prog(const int id, const int finished, const int total,
                     const string& text, const int numWorkers) {
-  ptime now = second_clock::local_time();
   double t = 0.0;
   {
-    ReadLock(_mutex);
+    ReadLock lock(_mutex);
     t = (Clock() - timers_[id]) * Clock::kSecInMicro;
   }
   double etc = t / finished * (total - finished) / numWorkers;
   if (!enabled()) {
     return etc;
   }
-  *_stream << "[ prog@" << now << "] ["
-           << finished << "/" << total
-           << " | etc "
-           << formatPerfTime(etc)
-           << "] " << text << "\n";
-  _stream->flush();
+  write(" prog", "[%i/%i | etc %s] %s", finished, total,
+        formatPerfTime(etc).c_str(), text.c_str());
   return etc;
 }
 
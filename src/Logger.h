@@ -3,6 +3,9 @@
 #define SRC_LOGGER_H_
 
 #include <boost/thread/shared_mutex.hpp>
+#include <boost/shared_ptr.hpp>
+#include <cstdarg>
+#include <cstdint>
 #include <string>
 #include <fstream>
 #include <iostream>
@@ -14,8 +17,24 @@ using std::ofstream;
 using std::ostream;
 using std::map;
 
+struct LogTarget;
+
+// Logs formatted messages to stdout or a file. Messages are formatted in the
+// calling thread and handed to a background writer through a lock-free ring
+// buffer owned by that thread, so logging from hot loops and server workers
+// does not serialise on the output stream.
 class Logger {
  public:
+  // Controls when written messages are flushed to the target.
+  enum FlushPolicy {
+    // Writes and flushes every message synchronously in the calling thread.
+    kFlushAlways,
+    // Flushes the target after each batch drained by the background writer.
+    kFlushBatch,
+    // Flushes the target at most every kFlushIntervalMs milliseconds.
+    kFlushInterval
+  };
+
   Logger();
   Logger(const Logger& other);
   ~Logger();
@@ -28,13 +47,27 @@ class Logger {
   // Sets the logging state.
   void enabled(const bool state);
 
-  // Sets the logger target file.
+  // Sets the logger target file. Copies of a logger share their target.
   // Empty ("") path redirects output to stdout.
   void target(const std::string& path);
 
   // Resets the logger target to stdout.
   void reset();
 
+  // Returns the flush policy.
+  FlushPolicy flushPolicy() const;
+
+  // Sets the flush policy.
+  void flushPolicy(const FlushPolicy policy);
+
+  // Blocks until all pending messages are written and the targets flushed.
+  void flush() const;
+
+  // Returns the number of messages dropped because the ring buffer of the
+  // logging thread was full. Errors are never dropped, they are written
+  // synchronously instead.
+  static uint64_t numDropped();
+
   // Shortens a message text to the maximum buffer size.
   string shorten(const string& text) const;
 
@@ -77,9 +110,15 @@ class Logger {
   // vsnprintf.
   size_t maxMessageLength() const;
 
+  static const int kFlushIntervalMs;
+
  private:
-  string path_;
-  ostream* _stream;
+  // Formats the message with the given tag and hands it to the writer.
+  void write(const char* tag, const char* format, va_list args) const;
+  void write(const char* tag, const char* format, ...) const;
+
+  boost::shared_ptr<LogTarget> _target;
+  FlushPolicy _flushPolicy;
   map<int, base::Clock> timers_;
   int timer_counter_;
   bool enabled_;
@@ -42,7 +42,7 @@ ScenarioGenerator::extractGtfsDirs(const string& args) const {
   return vec;
 }
 
-const TransitNetwork
+TransitNetwork
 ScenarioGenerator::gen(const string& networkName) {
   TransitNetwork network;
   vector<Trip> trips;
@@ -137,7 +137,7 @@ const Trip ScenarioGenerator::delayTrip(const Trip& trip, const int index,
                                         int delay) const {
   if (index >= trip.size())
     return trip;
-  Trip delayedTrip(trip.id());
+  Trip delayedTrip(trip.id(), trip.index());
   for (int i = 0; i < index; ++i)
     delayedTrip.addStop(trip.time().arr(i), trip.time().dep(i), trip.stop(i));
   for (int i = index; i < trip.size(); ++i)
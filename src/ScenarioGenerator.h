@@ -34,7 +34,7 @@ class ScenarioGenerator {
   explicit ScenarioGenerator(const vector<ScenarioParams>& params);
   explicit ScenarioGenerator(const ScenarioParams& params);
   // Generate and return a delayed version of the network.
-  const TransitNetwork gen(const std::string& networkName);
+  TransitNetwork gen(const std::string& networkName);
   const TransitNetwork& generatedNetwork() const;
   // Returns the last generated dc-lines
   const std::vector<Line>& generatedLines() const;
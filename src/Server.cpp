@@ -13,6 +13,7 @@
 #include <map>
 #include <set>
 #include <algorithm>
+#include <utility>
 #include "./Utilities.h"
 #include "./GtfsParser.h"
 #include "./Command.h"
@@ -47,7 +48,8 @@ void Worker::operator()() {
 
 Server::Server(const int port, const string& dataDir,
                const string& workDir, const string& logPath)
-    : _router(_network), _scenarioSet(false), _port(port), _dataDir(dataDir),
+    : _router(_network), _scenarioSet(false), _periodicDays(0), _port(port),
+      _dataDir(dataDir),
       _workDir(workDir), _maxWorkers(1), _activeWorkers(0) {
   _log.target(logPath);
   _router.logger(&_log);
@@ -99,12 +101,25 @@ TransitNetwork& Server::network() {
   return _network;
 }
 
+const TransitNetwork& Server::queryNetwork() const {
+  return _periodicNetwork.numNodes() ? _periodicNetwork : _network;
+}
+
+void Server::periodicDays(const int days) {
+  assert(days >= 0 && days < 64);
+  _periodicDays = days;
+}
+
+int Server::periodicDays() const {
+  return _periodicDays;
+}
+
 TransitNetwork& Server::scenario() {
   return _scenario;
 }
 
-void Server::scenario(const TransitNetwork& scenario) {
-  _scenario = scenario;
+void Server::scenario(TransitNetwork scenario) {
+  _scenario = std::move(scenario);
   _scenarioSet = true;
 }
 
@@ -174,6 +189,22 @@ void Server::loadGtfs(const vector<string>& paths,
   if (serialization && !loaded) {
     parser.save(_network, serialFile);
   }
+  _periodicNetwork = TransitNetwork();
+  if (_periodicDays) {
+    // The end time only selects the last day.
+    const string periodicEndStr =
+        time2str(startTime + kSecondsPerDay * (_periodicDays - 1));
+    GtfsParser periodicParser;
+    periodicParser.logger(&_log);
+    periodicParser.periodic(true);
+    const int perf_id = _log.beginPerf();
+    _periodicNetwork = periodicParser.createTransitNetwork(paths, startStr,
+                                                           periodicEndStr);
+    _periodicNetwork.preprocess();
+    _log.endPerf(perf_id, "periodic network construction");
+    _log.info("Periodic network for %d days has %d nodes.", _periodicDays,
+              _periodicNetwork.numNodes());
+  }
 }
 
 
@@ -244,10 +275,8 @@ void Server::precomputeTransferPatterns() {
     TPDB tpdb(network.numStops(), hubs);
     #pragma omp for schedule(dynamic, 3)
     for (size_t stop = 0; stop < numStops; ++stop) {
-      const set<vector<int> > patterns =
-          TransferPatternRouter::computeTransferPatterns(network, stop, hubs);
-      for (auto it = patterns.cbegin(), end = patterns.cend(); it != end; ++it)
-        tpdb.addPattern(*it);
+      TransferPatternRouter::computeTransferPatterns(network, stop, hubs,
+                                                     &tpdb.getGraph(stop));
       tpdb.finalise(stop);  // clears construction cache
 
       #pragma omp critical(progress_message)
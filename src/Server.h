@@ -45,8 +45,16 @@ class Server {
   void precomputeTransferPatterns();
   void run();
   TransitNetwork& network();
+  // Returns the network Dijkstra queries run on: the periodic network if one
+  // is loaded, the network otherwise.
+  const TransitNetwork& queryNetwork() const;
+  // Sets the number of days from the start time, at most 63, which loadGtfs
+  // also loads into a periodic network for Dijkstra queries. 0 (default) loads
+  // none. Transfer patterns are computed on the network.
+  void periodicDays(const int days);
+  int periodicDays() const;
   TransitNetwork& scenario();
-  void scenario(const TransitNetwork& scenario);
+  void scenario(TransitNetwork scenario);
   bool scenarioSet();
   void scenarioSet(bool value);
   TransferPatternRouter& router();
@@ -75,10 +83,12 @@ class Server {
   friend class Worker;
 
   TransitNetwork _network;
+  TransitNetwork _periodicNetwork;
   TransitNetwork _scenario;
   TransferPatternRouter _router;
   TransferPatternsDB _tpdb;
   bool _scenarioSet;
+  int _periodicDays;
 
   int _port;
   string _dataDir;
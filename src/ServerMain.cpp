@@ -21,7 +21,7 @@ const string kLogPathDef = "log/server.log";  // NOLINT
 bool parseArgs(int argc, char* argv[],
                int& port, string& workDir, string& dataDir,
                string& initDirs, string& logPath,
-               int& maxThreads);
+               int& maxThreads, int& periodicDays);
 
 int main(int argc, char* argv[]) {
   int port = kPortDef;
@@ -30,12 +30,14 @@ int main(int argc, char* argv[]) {
   string initDirs;
   string logPath = kLogPathDef;
   int maxThreads = 1;
+  int periodicDays = 0;
   if (!parseArgs(argc, argv, port, workDir, dataDir, initDirs, logPath,
-                 maxThreads)) {
+                 maxThreads, periodicDays)) {
     return 1;
   }
   Server server(port, dataDir, workDir, logPath);
   server.maxWorkers(maxThreads);
+  server.periodicDays(periodicDays);
   vector<string> dirVec = splitString(initDirs);
   for (auto it = dirVec.begin(); it != dirVec.end(); ++it) { it->append("/"); }
   server.loadGtfs(dirVec, firstOfMay(), firstOfMay() + kSecondsPerDay * 1 - 9);
@@ -52,7 +54,8 @@ int main(int argc, char* argv[]) {
 
 bool parseArgs(int argc, char* argv[],
                int& port, string& workDir, string& dataDir,
-               string& initDirs, string& logPath, int& maxThreads) {
+               string& initDirs, string& logPath, int& maxThreads,
+               int& periodicDays) {
   po::options_description args("Server options");
   args.add_options()
       ("help,h", "show help")
@@ -70,7 +73,11 @@ bool parseArgs(int argc, char* argv[],
        "log file path")
       ("maxWorkers,m",
        po::value<int>(&maxThreads)->default_value(1),
-       "maximum worker threads");
+       "maximum worker threads")
+      ("periodicdays,P",
+       po::value<int>(&periodicDays)->default_value(0),
+       "also load this many days (at most 63) as periodic network for "
+       "Dijkstra queries");
   po::variables_map vm;
   po::store(po::parse_command_line(argc, argv, args), vm);
   po::notify(vm);
@@ -79,5 +86,9 @@ bool parseArgs(int argc, char* argv[],
     cout << args << endl;
     return false;
   }
+  if (periodicDays < 0 || periodicDays > 63) {
+    cout << "periodicdays must be in [0, 63]" << endl;
+    return false;
+  }
   return true;
 }
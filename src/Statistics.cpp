@@ -66,7 +66,7 @@ int QueryCompare::compare(const vector<QueryResult::Path>& resultDi,
         const vector<int>& path = resultTp[i].second;
         bool containsHub = false;
         for (size_t j = 0; j < path.size(); j++) {
-          if (contains(*_hubs, path[j])) {
+          if (_hubs->contains(path[j])) {
             containsHub = true;
             break;
           }
@@ -34,6 +34,10 @@ class Stop {
   int nodeIndex(const int i) const { return _nodeIndices.at(i); }
   vector<int>::iterator nodesBegin() { return _nodeIndices.begin(); }
   vector<int>::iterator nodesEnd() { return _nodeIndices.end(); }
+  // Removes the node indices from the given position on.
+  void eraseNodeIndices(const vector<int>::iterator first) {
+    _nodeIndices.erase(first, _nodeIndices.end());
+  }
   // Compare operator.
   bool operator==(const Stop& other) const;
 
@@ -13,8 +13,53 @@
 using std::cout;
 using std::endl;
 
+namespace {
+// The (cost, penalty) pairs carried along by the arrival loop. Adding a pair
+// drops the following pairs up to the first with lower cost, like LabelVec.
+struct ArrivalBag {
+  ArrivalBag() : used(0) {}
+
+  void clear() { used = 0; }
+  bool empty() const { return !used; }
+
+  void add(const unsigned int cost, const unsigned char penalty) {
+    assert(penalty < LabelVec::kMaxFields);
+    costs[penalty] = cost;
+    used |= 1u << penalty;
+    for (int pos = penalty + 1; pos < LabelVec::kMaxFields &&
+         (!((used >> pos) & 1) || cost <= costs[pos]); ++pos) {
+      used &= ~(1u << pos);
+    }
+  }
+
+  unsigned int costs[LabelVec::kMaxFields];
+  uint32_t used;
+};
+
+// The transfer pattern traced back from a label, as its node in the transfer
+// patterns graph and the last stop. The last stop is added to the graph only
+// once the pattern continues to another stop, so that no node is added for a
+// stop that turns out to be the destination.
+struct TracedPrefix {
+  TracedPrefix() : node(0), last(-1) {}
+
+  // Appends a stop unless it repeats the last one.
+  void append(const int stop, TPG* graph) {
+    if (stop == (last == -1 ? graph->depStop() : last))
+      return;
+    if (last != -1)
+      node = graph->addPrefixNode(last, node);
+    last = stop;
+  }
+
+  int node;
+  int last;
+};
+}  // namespace
+
 const int TransferPatternRouter::TIME_LIMIT = 1 * 60 * 60;
 const unsigned char TransferPatternRouter::PENALTY_LIMIT = 3;
+const int TransferPatternRouter::NUM_LANDMARKS = 32;
 
 TransferPatternRouter::TransferPatternRouter(const TransitNetwork& network)
     : _network(network), _tpdb(NULL), _log(&LOG) {
@@ -24,6 +69,14 @@ TransferPatternRouter::TransferPatternRouter(const TransitNetwork& network)
 void TransferPatternRouter::prepare(const vector<Line>& lines) {
   _connections.init(_network.numStops(), lines);
   _timeCompressedNetwork = _network.createTimeCompressedNetwork();
+  // The compressed network rounds walks up to the transfer buffer, which the
+  // last walk to a destination does not take.
+  bool walk = false;
+  const vector<vector<Arc> >& walkways = _network.walkingGraph();
+  for (auto it = walkways.begin(); !walk && it != walkways.end(); ++it)
+    walk = !it->empty();
+  _landmarks.init(_timeCompressedNetwork, NUM_LANDMARKS,
+                  walk ? TransitNetwork::TRANSFER_BUFFER : 0);
 }
 
 
@@ -35,9 +88,18 @@ void TransferPatternRouter::computeAllTransferPatterns(TPDB* tpdb) {
   }
   const int numStops = _network.numStops();
   for (int stop = 0; stop < numStops; ++stop) {
-    set<vector<int> > pattern = computeTransferPatterns(_network, stop, _hubs);
-    for (auto it = pattern.cbegin(); it != pattern.cend(); ++it)
-      tpdb->addPattern(*it);
+    computeTransferPatterns(_network, stop, _hubs, &tpdb->getGraph(stop));
+  }
+}
+
+
+void TransferPatternRouter::computeTransferPatterns(
+    const TransitNetwork& network, const int depStop, const HubSet& hubs,
+    TPG* graph) {
+  if (hubs.size() && !hubs.contains(depStop)) {
+    computeTransferPatternsToHubs(network, depStop, hubs, graph);
+  } else {
+    computeTransferPatternsToAll(network, depStop, hubs, graph);
   }
 }
 
@@ -46,21 +108,17 @@ set<vector<int> >
 TransferPatternRouter::computeTransferPatterns(const TransitNetwork& network,
                                                const int depStop,
                                                const HubSet& hubs) {
-  set<vector<int> > patterns;
-  if (hubs.size() && !contains(hubs, depStop)) {
-    patterns = computeTransferPatternsToHubs(network, depStop, hubs);
-  } else {
-    patterns = computeTransferPatternsToAll(network, depStop, hubs);
-  }
-  return patterns;
+  TPG graph(depStop);
+  computeTransferPatterns(network, depStop, hubs, &graph);
+  return graph.patterns();
 }
 
 
-set<vector<int> >
-TransferPatternRouter::computeTransferPatternsToHubs(
+void TransferPatternRouter::computeTransferPatternsToHubs(
     const TransitNetwork& network,
     const int depStop,
-    const HubSet& hubs) {
+    const HubSet& hubs,
+    TPG* graph) {
   const vector<int> depNodes = network.getDepNodes(depStop);
   Dijkstra dijkstra(network);
   dijkstra.maxPenalty(PENALTY_LIMIT);
@@ -78,27 +136,29 @@ TransferPatternRouter::computeTransferPatternsToHubs(
     const LabelVec& labels = *it;
     if (labels.size()) {
       const int node = labels.at();
-      const int stop = network.node(node).stop();
+      const int stop = network.nodeStop(node);
       settledStops.insert(stop);
     }
   }
   // For all stops which have been reached remove suboptimal labels using the
-  // arrival loop algorithm and trace back the paths.
+  // arrival loop algorithm and trace back the paths. The arrival loops touch
+  // only the labels of their own stop and run in parallel.
   adjustWalkingCosts(network, &result.matrix);
-  for (auto it = settledStops.cbegin(), end = settledStops.cend();
-       it != end; ++it) {
-    const int stop = *it;
-    arrivalLoop(network, &result.matrix, stop);
+  const vector<int> stops(settledStops.begin(), settledStops.end());
+  const int numStops = stops.size();
+  #pragma omp parallel for schedule(dynamic, 16)
+  for (int i = 0; i < numStops; ++i) {
+    arrivalLoop(network, &result.matrix, stops[i]);
   }
-  return collectTransferPatterns(network, result.matrix, depStop);
+  collectTransferPatterns(network, result.matrix, depStop, graph);
 }
 
 
-set<vector<int> >
-TransferPatternRouter::computeTransferPatternsToAll(
+void TransferPatternRouter::computeTransferPatternsToAll(
     const TransitNetwork& network,
     const int depStop,
-    const HubSet& hubs) {
+    const HubSet& hubs,
+    TPG* graph) {
   // Do a full dijkstra from the set of nodes of the departure stop
   vector<int> depNodes = network.getDepNodes(depStop);
   Dijkstra dijkstra(network);
@@ -111,13 +171,14 @@ TransferPatternRouter::computeTransferPatternsToAll(
   adjustWalkingCosts(network, &result.matrix);
   // Get transfer Patterns to all stops in the network:
   const int numStops = network.numStops();
+  #pragma omp parallel for schedule(dynamic, 16)
   for (int targetStop = 0; targetStop < numStops; ++targetStop) {
     if (depStop == targetStop) {
       continue;
     }
     arrivalLoop(network, &result.matrix, targetStop);
   }
-  return collectTransferPatterns(network, result.matrix, depStop);
+  collectTransferPatterns(network, result.matrix, depStop, graph);
 }
 
 
@@ -147,8 +208,8 @@ TransferPatternRouter::generateAllTransferPatterns(const int orig) const {
 void TransferPatternRouter::adjustWalkingCosts(const TransitNetwork& network,
                                                LabelMatrix* matrix) {
   for (int j = 0; j < matrix->size(); j++) {
-    if (network.node(j).type() == Node::TRANSFER ||
-        network.node(j).type() == Node::DEPARTURE) {
+    if (network.nodeType(j) == Node::TRANSFER ||
+        network.nodeType(j) == Node::DEPARTURE) {
       for (auto it = matrix->at(j).begin(); it != matrix->at(j).end(); it++) {
         if (it->walk()) {
           assert(it->at() == j);
@@ -157,11 +218,7 @@ void TransferPatternRouter::adjustWalkingCosts(const TransitNetwork& network,
           int stopIndex = node.stop();
           int parentStopIndex = parentNode.stop();
           // Get matching arc between stop and parent stop:
-          int arcCost = INT_MAX;
-          const vector<Arc>& walkArcs = network.walkwayList(parentStopIndex);
-          for (size_t i = 0; i < walkArcs.size(); i++)
-            if (walkArcs[i].destination() == stopIndex)
-              arcCost = walkArcs[i].cost();
+          const int arcCost = network.walkCost(parentStopIndex, stopIndex);
           assert(arcCost != INT_MAX);
 
           // Adjust walking costs:
@@ -180,124 +237,102 @@ void TransferPatternRouter::arrivalLoop(const TransitNetwork& network,
                                         LabelMatrix* matrix,
                                         const int stop) {
   const vector<int>& stopNodes = network.stop(stop).getNodeIndices();
-  const int numStopNodes = stopNodes.size();
-  // collect arrival nodes and transfer nodes with walk label
-  vector<int> stopArrivalNodes;
-  stopArrivalNodes.reserve(numStopNodes / 3 * 2);
-
-  for (int i = 0; i < numStopNodes; i++) {
-    if (network.node(stopNodes[i]).type() == Node::ARRIVAL) {
-      stopArrivalNodes.push_back(stopNodes[i]);
-    } else {  // for TRANSFER and DEPARTURE
-      bool containsWalkNode = false;
-      for (auto it = matrix->at(stopNodes[i]).begin();
-           it != matrix->at(stopNodes[i]).end();
-           it++) {
-        if (it->walk())
-          containsWalkNode = true;
-      }
-      if (containsWalkNode)
-        stopArrivalNodes.push_back(stopNodes[i]);
+  // The labels reaching the previous node of the sweep and the current node.
+  ArrivalBag bags[2];
+  ArrivalBag* prev = &bags[0];
+  ArrivalBag* curr = &bags[1];
+  int prevNode = -1;
+  for (auto node = stopNodes.cbegin(), end = stopNodes.cend(); node != end;
+       ++node) {
+    // Arrival nodes take part with all labels, transfer and departure nodes
+    // only with their walk labels.
+    const bool arrival = network.nodeType(*node) == Node::ARRIVAL;
+    const LabelVec& labels = matrix->at(*node);
+    curr->clear();
+    for (auto label = labels.begin(), end2 = labels.end(); label != end2;
+         ++label) {
+      if (arrival || label->walk())
+        curr->add(label->cost(), label->penalty());
     }
-  }
-  // create a local copy of the nodes' label vectors
-  const int numStopArrivalNodes = stopArrivalNodes.size();
-  vector<LabelVec> tmpMatrix;
-  tmpMatrix.reserve(numStopArrivalNodes);
-  for (auto node = stopArrivalNodes.cbegin(), end = stopArrivalNodes.cend();
-       node != end; ++node) {
-    if (network.node(*node).type() == Node::ARRIVAL) {
-      tmpMatrix.push_back(matrix->at(*node));
-    } else {  // for TRANSFER and DEPARTURE
-      LabelVec tmpVector(*node, 12/*maxPenalty*/);
-      for (auto label = matrix->at(*node).begin();
-           label != matrix->at(*node).end();
-           label++) {
-        if (label->walk()) {
-          tmpVector.add(*label, matrix->parent(*label));
-        }
-      }
-      assert(tmpVector.size() > 0);
-      tmpMatrix.push_back(tmpVector);
-    }
-  }
-  assert(tmpMatrix.size() == stopArrivalNodes.size());
-
-  // arrival loop algorithm
-  if (numStopArrivalNodes) {
-    for (int i = 0; i < numStopArrivalNodes - 1; ++i) {
-      const int currNode = stopArrivalNodes[i];
-      const int nextNode = stopArrivalNodes[i+1];
-      const int timeDiff = network.node(nextNode).time() -
-                           network.node(currNode).time();
-      assert(timeDiff >= 0);
+    if (!arrival && curr->empty())
+      continue;
 
-      const LabelVec& nodeLabels = tmpMatrix[i];
-      for (auto labelIt = nodeLabels.begin(), end2 = nodeLabels.end();
-           labelIt != end2; ++labelIt) {
-        const LabelVec::Hnd& label = *labelIt;
-        const int alternativeCost = label.cost() + timeDiff;
-
-        // Deactivate all labels at nextNode which are strictly worse than the
-        // current label of currNode plus the time difference.
-        if (matrix->candidate(nextNode, alternativeCost, label.penalty())) {
-          tmpMatrix[i+1].add(alternativeCost, label.penalty(),
-                             label.maxPenalty(),
-                             false, false, NULL);
-          // deactivate the corresponding labels in the original vector
-          matrix->deactivate(nextNode, alternativeCost, label.penalty());
+    if (prevNode != -1) {
+      const int timeDiff = network.nodeTime(*node) -
+                           network.nodeTime(prevNode);
+      assert(timeDiff >= 0);
+      for (uint32_t used = prev->used; used; used &= used - 1) {
+        const unsigned char penalty = __builtin_ctz(used);
+        const int alternativeCost = prev->costs[penalty] + timeDiff;
+
+        // Deactivate all labels at the node which are strictly worse than
+        // the label of the previous node plus the time difference.
+        if (matrix->candidate(*node, alternativeCost, penalty)) {
+          curr->add(alternativeCost, penalty);
+          matrix->deactivate(*node, alternativeCost, penalty);
         }
       }
     }
+    std::swap(prev, curr);
+    prevNode = *node;
   }
 }
 
 
-set<vector<int> >
-TransferPatternRouter::collectTransferPatterns(const TransitNetwork& network,
-                                               const LabelMatrix& matrix,
-                                               const int depStop) {
-  set<vector<int> > patterns;
-  for (auto it = matrix.cbegin(), end = matrix.cend(); it != end; ++it) {
-    const LabelVec& labels = *it;
-    for (auto it2 = labels.begin(), end2 = labels.end(); it2 != end2; ++it2) {
-      vector<int> pattern;
-      LabelVec::Hnd label = *it2;
-      const Node& firstNode = network.node(label.at());
-      const Node::Type nodeType = firstNode.type();
-      if (!label.inactive()
-          && (nodeType == Node::ARRIVAL ||
-              (label.walk() && nodeType == Node::TRANSFER) ||
-              (label.walk() && nodeType == Node::DEPARTURE))
-          && firstNode.stop() != depStop) {
-        assert(label);
-        LabelVec::Hnd parent = matrix.parent(label);
-        assert(parent);
-        pattern.push_back(firstNode.stop());
-        while (label && parent && label.penalty() > 0) {
-          const int stop = network.node(label.at()).stop();
-          if (label.penalty() > parent.penalty()) {
-            if (pattern.back() != stop) {
-              pattern.push_back(stop);
-            }
-            const int parentStop = network.node(parent.at()).stop();
-            if (label.walk() && pattern.back() != parentStop) {
-              pattern.push_back(parentStop);
-            }
-          }
-          label = parent;
-          parent = matrix.parent(label);
+void TransferPatternRouter::collectTransferPatterns(
+    const TransitNetwork& network, const LabelMatrix& matrix,
+    const int depStop, TPG* graph) {
+  assert(graph && graph->depStop() == depStop);
+  // The traced prefix of each label visited so far. Labels sharing a prefix
+  // are traced back only once.
+  dense_hash_map<const LabelVec::Field*, TracedPrefix> traced;
+  traced.set_empty_key(NULL);
+  vector<LabelVec::Hnd> chain;
+  const int numNodes = matrix.size();
+  for (int node = 0; node < numNodes; ++node) {
+    const LabelVec& labels = matrix.at(node);
+    for (auto it = labels.begin(), end = labels.end(); it != end; ++it) {
+      const LabelVec::Hnd& label = *it;
+      const Node::Type nodeType = network.nodeType(label.at());
+      const int destStop = network.nodeStop(label.at());
+      if (label.inactive() || destStop == depStop ||
+          (nodeType != Node::ARRIVAL && !label.walk())) {
+        continue;
+      }
+      assert(matrix.parent(label));
+
+      // Walks up to the first label with known prefix, then traces the
+      // prefixes forward from there.
+      chain.clear();
+      TracedPrefix prefix;
+      for (LabelVec::Hnd hnd = label; ; hnd = matrix.parent(hnd)) {
+        const auto known = traced.find(hnd.field());
+        if (known != traced.end()) {
+          prefix = known->second;
+          break;
         }
-        if (pattern.back() != depStop) {
-          pattern.push_back(depStop);
+        const LabelVec::Hnd parent = matrix.parent(hnd);
+        if (!parent || hnd.penalty() == 0) {
+          traced[hnd.field()] = prefix;
+          break;
+        }
+        chain.push_back(hnd);
+      }
+      for (auto hnd = chain.rbegin(); hnd != chain.rend(); ++hnd) {
+        const LabelVec::Hnd parent = matrix.parent(*hnd);
+        if (hnd->penalty() > parent.penalty()) {
+          if (hnd->walk())
+            prefix.append(network.nodeStop(parent.at()), graph);
+          prefix.append(network.nodeStop(hnd->at()), graph);
         }
-        reverse(pattern.begin(), pattern.end());
-        assert(pattern[0] == depStop);
-        patterns.insert(pattern);
+        traced[hnd->field()] = prefix;
       }
+
+      if (prefix.last != destStop && prefix.last != -1)
+        prefix.node = graph->addPrefixNode(prefix.last, prefix.node);
+      graph->addDestNode(destStop, prefix.node);
     }
   }
-  return patterns;
 }
 
 
@@ -366,7 +401,7 @@ void TransferPatternRouter::countStopFreq(const int seedStop,
 }
 
 
-set<int> TransferPatternRouter::findBasicHubs(int numHubs) {
+HubSet TransferPatternRouter::findBasicHubs(int numHubs) {
   const int numStops = _network.numStops();
   vector<pair<int, int> > stops;
   stops.reserve(numStops);
@@ -376,7 +411,7 @@ set<int> TransferPatternRouter::findBasicHubs(int numHubs) {
 
   std::sort(stops.begin(), stops.end(), sortStopsByImportance());
 
-  set<int> hubs;
+  HubSet hubs;
   for (int i = 0; i < numHubs; ++i) {
     hubs.insert(stops[i].first);
   }
@@ -429,3 +464,8 @@ void TransferPatternRouter::transferPatternsDB(const TPDB& db) {
 const DirectConnection& TransferPatternRouter::directConnection() {
   return _connections;
 }
+
+
+const Landmarks& TransferPatternRouter::landmarks() const {
+  return _landmarks;
+}
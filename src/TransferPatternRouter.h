@@ -11,6 +11,7 @@
 #include "./Dijkstra.h"
 #include "./DirectConnection.h"
 #include "./Label.h"
+#include "./Landmarks.h"
 #include "./Logger.h"
 #include "./TransferPatternsDB.h"
 #include "./TransitNetwork.h"
@@ -37,15 +38,22 @@ class TransferPatternRouter {
  public:
   static const int TIME_LIMIT;
   static const unsigned char PENALTY_LIMIT;
+  static const int NUM_LANDMARKS;
 
   // Constructor
   explicit TransferPatternRouter(const TransitNetwork& network);
   FRIEND_TEST(TransferPatternRouterTest, Constructor);
 
   // Initializes the direct connection data structure and creates a time-inde-
-  // pendent network used for hub selection.
+  // pendent network used for hub selection and for the landmarks.
   void prepare(const vector<Line>& lines);
 
+  // Computes the transfer patterns of the departure stop into its graph.
+  static void computeTransferPatterns(const TransitNetwork& network,
+                                      const int depStop, const HubSet& hubs,
+                                      TPG* graph);
+
+  // Returns the transfer patterns of the departure stop.
   static
   set<vector<int> > computeTransferPatterns(const TransitNetwork& network,
                                             const int depStop,
@@ -56,16 +64,14 @@ class TransferPatternRouter {
   // Computes all transferPatterns between the given departure Stop and the
   // given Hubs. PLUS: To all other stops in the network which can't be reached
   // over a hub
-  static
-  set<vector<int> > computeTransferPatternsToHubs(const TransitNetwork& network,
-                                                  const int depStop,
-                                                  const HubSet& hubs);
+  static void computeTransferPatternsToHubs(const TransitNetwork& network,
+                                            const int depStop,
+                                            const HubSet& hubs, TPG* graph);
 
   // Computes the transfer patterns from the departure stop to any other stop.
-  static
-  set<vector<int> > computeTransferPatternsToAll(const TransitNetwork& network,
-                                                 const int depStop,
-                                                 const HubSet& hubs);
+  static void computeTransferPatternsToAll(const TransitNetwork& network,
+                                           const int depStop,
+                                           const HubSet& hubs, TPG* graph);
 
   // Constructs the QueryGraph from one stop to another, maybe empty. Uses hubs.
   const QueryGraph queryGraph(int depStop, int destStop) const;
@@ -80,7 +86,7 @@ class TransferPatternRouter {
 
   // Computes the hubs in the network by taking the number of nodes of each
   // stop into account. The stop wich has got the most nodes, is a hub.
-  set<int> findBasicHubs(int numHubs);
+  HubSet findBasicHubs(int numHubs);
 
   // Increases the counter for all stops which are on the optimal paths
   // from the seed stop.
@@ -114,6 +120,9 @@ class TransferPatternRouter {
 
   const DirectConnection& directConnection();
 
+  // Returns the landmarks for goal-directed searches on the network.
+  const Landmarks& landmarks() const;
+
  private:
   // Adds for every label at a transfer or departure node with walk == true a
   // new label to the matrix with costs = costs of the parent label + costs of
@@ -121,18 +130,20 @@ class TransferPatternRouter {
   // label.
   static void adjustWalkingCosts(const TransitNetwork& network,
                                  LabelMatrix* matrix);
-  // Performs the arrival loop algorithm. This method filters the vector
-  // QueryResult.costs for costs of arrival nodes at the stop. For the labels of
-  // these nodes, suboptimal paths are replaced by 'waiting from better paths'.
-  // Returns remaining label sets as a vector of size = #arrival nodes at stop.
+  // Performs the arrival loop algorithm. Sweeps the arrival nodes of the stop
+  // and its transfer and departure nodes with walk labels in time order,
+  // carrying the best labels along. Labels that are worse than waiting from
+  // an earlier node are deactivated in place.
   static void arrivalLoop(const TransitNetwork& network, LabelMatrix* matrix,
                           const int stop);
   FRIEND_TEST(TransferPatternRouterTest, arrivalLoop_transitivity);
 
-  // Computes all transfer patterns via backtracking of Labels in the matrix.
-  static set<vector<int> >
-  collectTransferPatterns(const TransitNetwork& network,
-                          const LabelMatrix& matrix, const int depStop);
+  // Adds all transfer patterns to the graph via backtracking of Labels in the
+  // matrix. Each label is traced back once, patterns sharing a prefix share
+  // the work and the graph nodes.
+  static void collectTransferPatterns(const TransitNetwork& network,
+                                      const LabelMatrix& matrix,
+                                      const int depStop, TPG* graph);
 
   // The network.
   const TransitNetwork& _network;
@@ -142,6 +153,9 @@ class TransferPatternRouter {
   // The search structure for direct connection queries.
   DirectConnection _connections;
 
+  // The landmarks of the time-compressed network.
+  Landmarks _landmarks;
+
   // Stores for every pair of stops a list of all transferPatterns from the
   // first stop to the second
   const TransferPatternsDB* _tpdb;
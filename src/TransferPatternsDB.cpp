@@ -1,6 +1,7 @@
 // Copyright 2011: Eugen Sawin, Philip Stahl, Jonas Sternisko
 #include "./TransferPatternsDB.h"
 #include <boost/foreach.hpp>
+#include <algorithm>
 #include <cassert>
 #include <cstring>  // for size_t
 #include <vector>
@@ -13,23 +14,25 @@
 // TransferPatternsGraph
 
 const int TPG::INVALID_NODE = -1;
-const set<int> TPG::_emptySet = set<int>();
-const HubSet* TPG::_hubs = NULL;
+
+TPG::PrefixMap TPG::emptyPrefixMap() {
+  PrefixMap prefixMap;
+  prefixMap.set_empty_key(UINT64_MAX);
+  return prefixMap;
+}
 
 TPG::TransferPatternsGraph(const TPG& rhs)
-  : _nodes(rhs._nodes), _successors(rhs._successors),
+  : _hubs(rhs._hubs), _nodes(rhs._nodes), _successors(rhs._successors),
     _destHubs(rhs._destHubs), _destMap(rhs._destMap),
     _prefixMap(rhs._prefixMap) {}
 
 TPG::TransferPatternsGraph(const int depStop)
-  : _nodes(1, depStop), _successors(1, vector<int>()) {
-  _hubs = NULL;
-}
+  : _hubs(NULL), _nodes(1, depStop), _successors(1, vector<int>()),
+    _prefixMap(emptyPrefixMap()) {}
 
 TPG::TransferPatternsGraph(const int depStop, const HubSet& hubs)
-  : _nodes(1, depStop), _successors(1, vector<int>()) {
-  _hubs = &hubs;
-}
+  : _hubs(&hubs), _nodes(1, depStop), _successors(1, vector<int>()),
+    _prefixMap(emptyPrefixMap()) {}
 
 int TPG::numNodes() const {
   return _nodes.size();
@@ -79,10 +82,10 @@ int TPG::addPrefixNode(const int stop, const int successor) {
   assert(successor >= 0 && static_cast<size_t>(successor) < _nodes.size());
   int prefix = findProperPrefix(stop, successor);
   if (prefix == INVALID_NODE) {
+    prefix = _nodes.size();
     _successors.push_back(vector<int>(1, successor));
     _nodes.push_back(stop);
-    safeInsert(_prefixMap, stop, _nodes.size() - 1);
-    prefix = _nodes.size() - 1;
+    _prefixMap[prefixKey(stop, successor)] = prefix;
   }
   return prefix;
 }
@@ -96,7 +99,7 @@ int TPG::addDestNode(const int stop, const int successor) {
     _destMap[stop] = dest;
     _successors.push_back(vector<int>(1, successor));
     _nodes.push_back(stop);
-    if (_hubs && _hubs->find(stop) != _hubs->end()) {
+    if (_hubs && _hubs->contains(stop)) {
       _destHubs.insert(stop);
     }
   } else if (!contains(_successors[dest], successor)) {
@@ -107,32 +110,39 @@ int TPG::addDestNode(const int stop, const int successor) {
 
 
 int TPG::findProperPrefix(const int stop, const int successor) const {
-  const set<int>& nodes = prefixNodes(stop);
-  for (auto it = nodes.begin(), end = nodes.end(); it != end; ++it) {
-    assert(successors(*it).size() == 1);
-    if (successors(*it).back() == successor) {
-      return *it;
-    }
+  auto const it = _prefixMap.find(prefixKey(stop, successor));
+  if (it == _prefixMap.end()) {
+    return INVALID_NODE;
   }
-  return INVALID_NODE;
+  assert(successors(it->second).size() == 1);
+  return it->second;
 }
 
-const set<int>& TPG::prefixNodes(const int stop) const {
-  auto const it = _prefixMap.find(stop);
-  if (it == _prefixMap.end()) {
-    return _emptySet;
-  } else {
-    return it->second;
+set<vector<int> > TPG::patterns() const {
+  set<vector<int> > patterns;
+  for (auto it = _destMap.begin(); it != _destMap.end(); ++it) {
+    const vector<int>& succs = _successors[it->second];
+    for (auto succ = succs.begin(); succ != succs.end(); ++succ) {
+      vector<int> pattern(1, it->first);
+      for (int node = *succ; node != 0; node = _successors[node][0]) {
+        assert(_successors[node].size() == 1);
+        pattern.push_back(_nodes[node]);
+      }
+      pattern.push_back(_nodes[0]);
+      std::reverse(pattern.begin(), pattern.end());
+      patterns.insert(pattern);
+    }
   }
+  return patterns;
 }
 
 void TPG::finalise() {
-  _prefixMap.clear();
   // making sure the memory is freed
-  map<int, set<int> >().swap(_prefixMap);
+  emptyPrefixMap().swap(_prefixMap);
 }
 
 TPG& TPG::operator=(const TPG& rhs) {
+  _hubs = rhs._hubs;
   _nodes = rhs._nodes;
   _successors = rhs._successors;
   _destHubs = rhs._destHubs;
@@ -5,6 +5,8 @@
 #include <boost/serialization/map.hpp>
 #include <boost/serialization/set.hpp>
 #include <boost/serialization/vector.hpp>
+#include <google/dense_hash_map>
+#include <stdint.h>
 #include <vector>
 #include <map>
 #include <set>
@@ -14,6 +16,7 @@
 using std::vector;
 using std::map;
 using std::set;
+using google::dense_hash_map;
 
 // Directed acyclic graph holding the transfer patterns in reversed direction
 // - from destination stops to the departure stop.
@@ -21,9 +24,6 @@ class TransferPatternsGraph {
  public:
   static const int INVALID_NODE;
 
-  // Pointer to the hubs set.
-  static const HubSet* _hubs;
-
   // Copy constructor.
   TransferPatternsGraph(const TransferPatternsGraph& rhs);
 
@@ -57,6 +57,19 @@ class TransferPatternsGraph {
   // Adds nodes and connections according to the given transfer pattern.
   void addPattern(const vector<int>& stops);
 
+  // Connects a prefix node for given stop to its successor node.
+  // Adds a new prefix node on demand.
+  // Returns the index of the prefix node.
+  int addPrefixNode(const int stop, const int successor);
+
+  // Connects a destination node for given stop to its successor node.
+  // Adds a new destination node on demand.
+  // Returns the index of the destination node.
+  int addDestNode(const int stop, const int successor);
+
+  // Returns all transfer patterns held by the graph.
+  set<vector<int> > patterns() const;
+
   // Cleares cache required for efficient graph construction.
   // Use this after construction to increase query-time efficiency.
   void finalise();
@@ -74,17 +87,16 @@ class TransferPatternsGraph {
   std::string debugString() const;
 
  private:
-  static const set<int> _emptySet;
+  // Prefix nodes keyed by their stop and successor node.
+  typedef dense_hash_map<uint64_t, int> PrefixMap;
 
-  // Connects a prefix node for given stop to its successor node.
-  // Adds a new prefix node on demand.
-  // Returns the index of the prefix node.
-  int addPrefixNode(const int stop, const int successor);
+  // Returns the key of a prefix node in the prefix map.
+  static uint64_t prefixKey(const int stop, const int successor) {
+    return static_cast<uint64_t>(stop) << 32 | static_cast<uint32_t>(successor);
+  }
 
-  // Connects a destination node for given stop to its successor node.
-  // Adds a new destination node on demand.
-  // Returns the index of the destination node.
-  int addDestNode(const int stop, const int successor);
+  // Returns an empty prefix map.
+  static PrefixMap emptyPrefixMap();
 
   // Returns the first node of a prefix, which conforms to the given connection
   // stop -> successor if available and INVALID_NODE rhswise.
@@ -92,8 +104,9 @@ class TransferPatternsGraph {
   // C->B->A and B->A are the only proper prefixes.
   int findProperPrefix(const int stop, const int successor) const;
 
-  // Returns the prefix nodes for given stop.
-  const set<int>& prefixNodes(const int stop) const;
+  // The hubs of the database, not owned. Not serialized, a loaded graph does
+  // not track new hub destinations.
+  const HubSet* _hubs;
 
   vector<int> _nodes;
   vector<vector<int> > _successors;  // TODO(jonas): could be vector<set<int> >
@@ -101,10 +114,10 @@ class TransferPatternsGraph {
   map<int, int> _destMap;
 
   // Used only during graph construction; cleared on finalising.
-  map<int, set<int> > _prefixMap;
+  PrefixMap _prefixMap;
 
   // Default Constructor needed for serialization.
-  TransferPatternsGraph() {}
+  TransferPatternsGraph() : _hubs(NULL), _prefixMap(emptyPrefixMap()) {}
 
   // Serialization.
   template<class Archive>
@@ -132,6 +145,7 @@ class TransferPatternsDB {
   TransferPatternsDB(const int numStops, const HubSet& hubs);
 
   // Initialises the database given the total number of stops and the hubs.
+  // The hubs are referenced by the graphs and must outlive the database.
   void init(const int numStops, const HubSet& hubs);
 
   // Addition operator used for reduction of parallel results. Asserts both TPDB
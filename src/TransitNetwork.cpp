@@ -1,6 +1,8 @@
 // Copyright 2011: Eugen Sawin, Philip Stahl, Jonas Sternisko
 #include "./TransitNetwork.h"
 #include <cassert>
+#include <climits>
+#include <cmath>
 #include <limits>
 #include <vector>
 #include <string>
@@ -36,34 +38,29 @@ string type2Str(const Node::Type type) {
 }
 
 
-bool CompareNodesByTime::operator()(const int& a, const int& b) {
-  const Node& node1 = _nodes->at(a);
-  const Node& node2 = _nodes->at(b);
-  if (node1.time() < node2.time())
-    return true;
-  else if (node1.time() == node2.time() &&
-           node1.type() == Node::TRANSFER  && node2.type() == Node::DEPARTURE)
-    return true;
-  else
-    return false;
-}
-
-
 // string Node::debugString() const {
 //   return "stop: " + convert<string>(_stop) + "," + type2Str(_type) + "@" +
 //          time2str(_time);
 // }
 
 
+namespace {
+// Stops with more nodes are searched in the Eytzinger layout. The times of
+// smaller stops fit in a few cache lines and are searched directly.
+const int kMaxDirectSearchSize = 32;
+}  // namespace
+
+
 // _____________________________________________________________________________
 // TRANSITNETWORK METHODS
 
 const int TransitNetwork::TRANSFER_BUFFER = 120;
 const float TransitNetwork::MAX_WALKWAY_DIST = 100.0f;
+size_t TransitNetwork::_numCopies = 0;
 
 
 TransitNetwork::TransitNetwork()
-    : _numArcs(0) {
+    : _timeEpoch(0), _numArcs(0), _maxWalkTime(0), _period(0) {
   _stopId2indexMap.set_empty_key("");
   reset();
 }
@@ -74,51 +71,142 @@ TransitNetwork::~TransitNetwork() {
 
 
 TransitNetwork::TransitNetwork(const TransitNetwork& other)
-    : _nodes(other._nodes), _adjacencyLists(other._adjacencyLists),
+    : _nodeStops(other._nodeStops), _nodeTimes(other._nodeTimes),
+    _nodeTypes(other._nodeTypes), _timeEpoch(other._timeEpoch),
+    _adjacencyLists(other._adjacencyLists),
     _numArcs(other._numArcs), _stops(other._stops),
-    _stopId2indexMap(other._stopId2indexMap), _name(other._name) {
+    _stopLats(other._stopLats), _stopLons(other._stopLons),
+    _stopNodes(other._stopNodes), _stopTimes(other._stopTimes),
+    _stopTimeOffsets(other._stopTimeOffsets),
+    _stopTimeIndex(other._stopTimeIndex), _stopTimeRanks(other._stopTimeRanks),
+    _walkwayLists(other._walkwayLists), _walkCostHeads(other._walkCostHeads),
+    _walkCosts(other._walkCosts), _walkCostOffsets(other._walkCostOffsets),
+    _maxWalkTime(other._maxWalkTime), _period(other._period),
+    _nodeDays(other._nodeDays), _stopId2indexMap(other._stopId2indexMap),
+    _name(other._name) {
   _mapOfStops = other._mapOfStops;
-  _walkwayLists = other._walkwayLists;
   _geoInfo = other.geoInfo();
+  __sync_fetch_and_add(&_numCopies, 1);
 }
 
 
 TransitNetwork& TransitNetwork::operator=(const TransitNetwork& other) {
-  _nodes = other._nodes;
+  _nodeStops = other._nodeStops;
+  _nodeTimes = other._nodeTimes;
+  _nodeTypes = other._nodeTypes;
+  _timeEpoch = other._timeEpoch;
   _adjacencyLists = other._adjacencyLists;
   _numArcs = other._numArcs;
   _stops = other._stops;
+  _stopLats = other._stopLats;
+  _stopLons = other._stopLons;
+  _stopNodes = other._stopNodes;
+  _stopTimes = other._stopTimes;
+  _stopTimeOffsets = other._stopTimeOffsets;
+  _stopTimeIndex = other._stopTimeIndex;
+  _stopTimeRanks = other._stopTimeRanks;
   _stopId2indexMap = other._stopId2indexMap;
   _name = other._name;
   _mapOfStops = other._mapOfStops;
   _walkwayLists = other._walkwayLists;
+  _walkCostHeads = other._walkCostHeads;
+  _walkCosts = other._walkCosts;
+  _walkCostOffsets = other._walkCostOffsets;
+  _maxWalkTime = other._maxWalkTime;
+  _period = other._period;
+  _nodeDays = other._nodeDays;
   _geoInfo = other.geoInfo();
+  __sync_fetch_and_add(&_numCopies, 1);
   return *this;
 }
 
 
+TransitNetwork::TransitNetwork(TransitNetwork&& other)
+    : _timeEpoch(0), _numArcs(0), _maxWalkTime(0), _period(0) {
+  _stopId2indexMap.set_empty_key("");
+  *this = std::move(other);
+}
+
+
+TransitNetwork& TransitNetwork::operator=(TransitNetwork&& other) {
+  if (this == &other)
+    return *this;
+  _nodeStops = std::move(other._nodeStops);
+  _nodeTimes = std::move(other._nodeTimes);
+  _nodeTypes = std::move(other._nodeTypes);
+  _timeEpoch = other._timeEpoch;
+  _adjacencyLists = std::move(other._adjacencyLists);
+  _numArcs = other._numArcs;
+  _stops = std::move(other._stops);
+  _stopLats = std::move(other._stopLats);
+  _stopLons = std::move(other._stopLons);
+  _stopNodes = std::move(other._stopNodes);
+  _stopTimes = std::move(other._stopTimes);
+  _stopTimeOffsets = std::move(other._stopTimeOffsets);
+  _stopTimeIndex = std::move(other._stopTimeIndex);
+  _stopTimeRanks = std::move(other._stopTimeRanks);
+  _stopId2indexMap.swap(other._stopId2indexMap);
+  other._stopId2indexMap.clear();
+  _name = std::move(other._name);
+  // The kdtree points to the stops, which kept their storage.
+  _mapOfStops = other._mapOfStops;
+  other._mapOfStops.clear();
+  _walkwayLists = std::move(other._walkwayLists);
+  _walkCostHeads = std::move(other._walkCostHeads);
+  _walkCosts = std::move(other._walkCosts);
+  _walkCostOffsets = std::move(other._walkCostOffsets);
+  _maxWalkTime = other._maxWalkTime;
+  _period = other._period;
+  _nodeDays = std::move(other._nodeDays);
+  _geoInfo = other._geoInfo;
+  other.reset();
+  return *this;
+}
+
+
+size_t TransitNetwork::numCopies() {
+  return _numCopies;
+}
+
+
 void TransitNetwork::reset() {
   _name = "";
-  _nodes.clear();
+  _nodeStops.clear();
+  _nodeTimes.clear();
+  _nodeTypes.clear();
+  _timeEpoch = 0;
   _adjacencyLists.clear();
   _numArcs = 0;
   _stops.clear();
+  _stopLats.clear();
+  _stopLons.clear();
+  _stopNodes.clear();
+  _stopTimes.clear();
+  _stopTimeOffsets.clear();
+  _stopTimeIndex.clear();
+  _stopTimeRanks.clear();
   _walkwayLists.clear();
+  _walkCostHeads.clear();
+  _walkCosts.clear();
+  _walkCostOffsets.clear();
+  _maxWalkTime = 0;
+  _period = 0;
+  _nodeDays.clear();
 }
 
 
 void TransitNetwork::validate() const {
   for (size_t n = 0; n < _adjacencyLists.size(); ++n) {
-    const Node::Type nodeType = _nodes.at(n).type();
+    const Node::Type type = nodeType(n);
     const vector<Arc>& arcs = _adjacencyLists.at(n);
     for (auto arcIt = arcs.begin(); arcIt != arcs.end(); ++arcIt) {
       const Arc& arc = *arcIt;
-      const Node::Type succType = _nodes.at(arc.destination()).type();
-      assert((nodeType == Node::TRANSFER &&
+      const Node::Type succType = nodeType(arc.destination());
+      assert((type == Node::TRANSFER &&
               (succType == Node::TRANSFER || succType == Node::DEPARTURE)) ||
-             (nodeType == Node::ARRIVAL &&
+             (type == Node::ARRIVAL &&
               (succType == Node::DEPARTURE || succType == Node::TRANSFER)) ||
-             (nodeType == Node::DEPARTURE && succType == Node::ARRIVAL));
+             (type == Node::DEPARTURE && succType == Node::ARRIVAL));
     }
   }
 //  for (int i = 0; i < numStops(); i++) {
@@ -132,15 +220,99 @@ void TransitNetwork::validate() const {
 
 void TransitNetwork::preprocess() {
   validate();
+  if (!hasStopTimes())
+    buildStopTimes();
   buildKdtreeFromStops();
   // set up the walkway lists if not yet done
   if (_walkwayLists.size() == 0) {
     buildWalkingGraph(MAX_WALKWAY_DIST);
+  } else {
+    buildWalkCosts();
   }
   computeGeoInfo();
 }
 
 
+void TransitNetwork::addWalkArcs(const int maxWalkTime) {
+  assert(maxWalkTime > 0);
+  assert(_maxWalkTime == 0);
+  assert(hasStopTimes());
+  const int numStops_ = numStops();
+  vector<vector<Arc> > walkwayLists(numStops_);
+  #pragma omp parallel for schedule(dynamic, 64)
+  for (int i = 0; i < numStops_; ++i)
+    walkwayLists[i] = closedWalkways(i, maxWalkTime);
+  _walkwayLists.swap(walkwayLists);
+  buildWalkCosts();
+  _maxWalkTime = maxWalkTime;
+
+  // Like Dijkstra::expandWalkNode, an arrival node reaches the start nodes at
+  // the other stop from its time plus walking time and transfer buffer on.
+  size_t numArcs = 0;
+  #pragma omp parallel for schedule(dynamic, 16) reduction(+:numArcs)
+  for (int i = 0; i < numStops_; ++i) {
+    const pair<const int*, const int*> nodes = stopNodes(i);
+    for (const int* node = nodes.first; node != nodes.second; ++node) {
+      if (nodeType(*node) != Node::ARRIVAL)
+        continue;
+      const int time = nodeTime(*node);
+      vector<Arc>& arcs = _adjacencyLists[*node];
+      for (auto walkway = _walkwayLists[i].begin();
+           walkway != _walkwayLists[i].end(); ++walkway) {
+        const int succTime = time + walkway->cost() + TRANSFER_BUFFER;
+        const StartNodeRange succs = startNodes(walkway->destination(),
+                                                succTime);
+        for (auto succ = succs.begin(); succ != succs.end(); ++succ) {
+          arcs.push_back(Arc(*succ, succTime - time + waitTime(succTime, *succ),
+                             walkway->penalty(), true));
+          ++numArcs;
+        }
+      }
+    }
+  }
+  _numArcs += numArcs;
+}
+
+
+vector<Arc> TransitNetwork::closedWalkways(const int stop,
+                                           const int maxWalkTime) const {
+  // Dijkstra on the walking graph. Walkways of the given stop are kept beyond
+  // the walking time, but not walked on.
+  dense_hash_map<int, int> costs;
+  costs.set_empty_key(-1);
+  typedef pair<int, int> Entry;
+  priority_queue<Entry, vector<Entry>, std::greater<Entry> > queue;
+  costs[stop] = 0;
+  queue.push(make_pair(0, stop));
+  vector<Arc> closed;
+  while (!queue.empty()) {
+    const int cost = queue.top().first;
+    const int s = queue.top().second;
+    queue.pop();
+    if (cost > costs[s])
+      continue;
+    // A walk over several walkways is a single walking transfer.
+    if (s != stop)
+      closed.push_back(Arc(s, cost, 1));
+    for (auto arc = _walkwayLists[s].begin(); arc != _walkwayLists[s].end();
+         ++arc) {
+      const int succCost = cost + arc->cost();
+      if (s != stop && succCost > maxWalkTime)
+        continue;
+      auto succ = costs.find(arc->destination());
+      if (succ == costs.end() || succCost < succ->second) {
+        costs[arc->destination()] = succCost;
+        queue.push(make_pair(succCost, arc->destination()));
+      }
+    }
+  }
+  std::sort(closed.begin(), closed.end(), [](const Arc& a, const Arc& b) {
+    return a.destination() < b.destination();
+  });
+  return closed;
+}
+
+
 TransitNetwork TransitNetwork::createTimeCompressedNetwork() const {
   TransitNetwork compressed;
   // For each stop in the original network, add a stop and with one node.
@@ -162,8 +334,9 @@ TransitNetwork TransitNetwork::createTimeCompressedNetwork() const {
       for (auto arcIter = _adjacencyLists[*nodeIter].begin();
            arcIter != _adjacencyLists[*nodeIter].end(); ++arcIter) {
         const Arc& arc = *arcIter;
-        const uint stopB = static_cast<uint>(_nodes[arc.destination()].stop());
-        if (i != stopB) {
+        const uint stopB = static_cast<uint>(nodeStop(arc.destination()));
+        // The walkways are added below.
+        if (i != stopB && !arc.walk()) {
           auto result = minCosts.find(stopB);
           if (result == minCosts.end() || arc.cost() < minCosts[stopB])
             minCosts[stopB] = arc.cost();
@@ -192,7 +365,7 @@ TransitNetwork TransitNetwork::createTimeCompressedNetwork() const {
 // all arcs mirrored. On this network, the largest connected component is found.
 // Finally, the stops of this component are translated into stops of the
 // original network including all node indices.
-const TransitNetwork TransitNetwork::largestConnectedComponent() const {
+TransitNetwork TransitNetwork::largestConnectedComponent() const {
   // determine node indices of the largest connected component
   TransitNetwork bidirect = createTimeCompressedNetwork().mirrored();
   vector<bool> visitedMarks(bidirect.numNodes(), false);
@@ -210,12 +383,14 @@ const TransitNetwork TransitNetwork::largestConnectedComponent() const {
   // nodes and all arcs between such stops
   TransitNetwork lcc = *this;
   lcc._stops.clear();
+  lcc._stopLats.clear();
+  lcc._stopLons.clear();
   lcc._stopId2indexMap.clear();
   vector<bool> inserted(bidirect.numStops(), false);
   for (auto node = largestComponentNodes.cbegin();
        node != largestComponentNodes.end();
        ++node) {
-    const size_t stopIndex = bidirect.node(*node).stop();  // index from bidirec
+    const size_t stopIndex = bidirect.nodeStop(*node);  // index from bidirec
     if (!inserted[stopIndex]) {
       Stop s = stop(stopIndex);  // copy from the original network
       lcc.addStop(s);
@@ -228,7 +403,175 @@ const TransitNetwork TransitNetwork::largestConnectedComponent() const {
 }
 
 
-const TransitNetwork TransitNetwork::mirrored() const {
+vector<int> TransitNetwork::renumberNodes() {
+  const int numNodes = this->numNodes();
+  // Order the stops breadth-first along the arcs, stops served one after
+  // another by trips end up close to each other.
+  vector<int> stopOrder;
+  stopOrder.reserve(_stops.size());
+  vector<bool> visited(_stops.size(), false);
+  for (size_t root = 0; root < _stops.size(); ++root) {
+    if (visited[root])
+      continue;
+    visited[root] = true;
+    stopOrder.push_back(root);
+    for (size_t k = stopOrder.size() - 1; k < stopOrder.size(); ++k) {
+      const vector<int>& nodes = _stops[stopOrder[k]].getNodeIndices();
+      for (auto node = nodes.begin(); node != nodes.end(); ++node) {
+        const vector<Arc>& arcs = _adjacencyLists[*node];
+        for (auto arc = arcs.begin(); arc != arcs.end(); ++arc) {
+          const int succStop = nodeStop(arc->destination());
+          if (!visited[succStop]) {
+            visited[succStop] = true;
+            stopOrder.push_back(succStop);
+          }
+        }
+      }
+    }
+  }
+
+  // Number the nodes stop by stop, nodes without a stop go last.
+  vector<int> newIndex(numNodes, -1);
+  vector<int> oldIndex;
+  oldIndex.reserve(numNodes);
+  for (auto stop = stopOrder.begin(); stop != stopOrder.end(); ++stop) {
+    const vector<int>& nodes = _stops[*stop].getNodeIndices();
+    for (auto node = nodes.begin(); node != nodes.end(); ++node) {
+      if (newIndex[*node] == -1) {
+        newIndex[*node] = oldIndex.size();
+        oldIndex.push_back(*node);
+      }
+    }
+  }
+  for (int i = 0; i < numNodes; ++i) {
+    if (newIndex[i] == -1) {
+      newIndex[i] = oldIndex.size();
+      oldIndex.push_back(i);
+    }
+  }
+
+  // Permute the node arrays. Chunks of whole type words keep the threads from
+  // writing to the same word.
+  vector<int> nodeStops(numNodes);
+  vector<int32_t> nodeTimes(numNodes);
+  vector<uint64_t> nodeTypes(_nodeTypes.size(), 0);
+  vector<uint64_t> nodeDays(_nodeDays.size());
+  vector<vector<Arc> > adjacencyLists(numNodes);
+  #pragma omp parallel for schedule(dynamic, 32 * kTypesPerWord)
+  for (int i = 0; i < numNodes; ++i) {
+    const int old = oldIndex[i];
+    nodeStops[i] = _nodeStops[old];
+    nodeTimes[i] = _nodeTimes[old];
+    if (_period)
+      nodeDays[i] = _nodeDays[old];
+    nodeTypes[i / kTypesPerWord] |=
+        static_cast<uint64_t>(nodeType(old)) << (i % kTypesPerWord * 2);
+    const vector<Arc>& arcs = _adjacencyLists[old];
+    vector<Arc>& newArcs = adjacencyLists[i];
+    newArcs.reserve(arcs.size());
+    for (auto arc = arcs.begin(); arc != arcs.end(); ++arc)
+      newArcs.push_back(Arc(newIndex[arc->destination()], arc->cost(),
+                            arc->penalty(), arc->walk()));
+  }
+  _nodeStops.swap(nodeStops);
+  _nodeTimes.swap(nodeTimes);
+  _nodeTypes.swap(nodeTypes);
+  _nodeDays.swap(nodeDays);
+  _adjacencyLists.swap(adjacencyLists);
+
+  // The node lists of the stops keep their order, so the stop times and their
+  // search index stay valid.
+  for (size_t i = 0; i < _stops.size(); ++i) {
+    for (auto node = _stops[i].nodesBegin(); node != _stops[i].nodesEnd();
+         ++node)
+      *node = newIndex[*node];
+  }
+  for (auto node = _stopNodes.begin(); node != _stopNodes.end(); ++node)
+    *node = newIndex[*node];
+  return oldIndex;
+}
+
+
+vector<int> TransitNetwork::reduce() {
+  const int numNodes = this->numNodes();
+  const bool stopTimes = hasStopTimes();
+  vector<char> reached(numNodes, 0);
+  vector<int> lastTransferTimes(_stops.size(), INT_MIN);
+  for (int i = 0; i < numNodes; ++i) {
+    const vector<Arc>& arcs = _adjacencyLists[i];
+    for (auto arc = arcs.begin(); arc != arcs.end(); ++arc)
+      reached[arc->destination()] = 1;
+    if (nodeType(i) == Node::TRANSFER) {
+      int& lastTime = lastTransferTimes[nodeStop(i)];
+      lastTime = std::max(lastTime, nodeTime(i));
+    }
+  }
+  vector<int> newIndex(numNodes, -1);
+  vector<int> oldIndex;
+  oldIndex.reserve(numNodes);
+  for (int i = 0; i < numNodes; ++i) {
+    const Node::Type type = nodeType(i);
+    if (type == Node::ARRIVAL && !reached[i])
+      continue;
+    if (type == Node::DEPARTURE && _adjacencyLists[i].empty() &&
+        nodeTime(i) <= lastTransferTimes[nodeStop(i)])
+      continue;
+    newIndex[i] = oldIndex.size();
+    oldIndex.push_back(i);
+  }
+
+  // As in renumberNodes, the chunks are multiples of the type words.
+  const int numReduced = oldIndex.size();
+  vector<int> nodeStops(numReduced);
+  vector<int32_t> nodeTimes(numReduced);
+  vector<uint64_t> nodeTypes((numReduced + kTypesPerWord - 1) / kTypesPerWord,
+                             0);
+  vector<uint64_t> nodeDays(_period ? numReduced : 0);
+  vector<vector<Arc> > adjacencyLists(numReduced);
+  size_t numArcs = 0;
+  #pragma omp parallel for schedule(dynamic, 32 * kTypesPerWord) \
+      reduction(+:numArcs)
+  for (int i = 0; i < numReduced; ++i) {
+    const int old = oldIndex[i];
+    nodeStops[i] = _nodeStops[old];
+    nodeTimes[i] = _nodeTimes[old];
+    if (_period)
+      nodeDays[i] = _nodeDays[old];
+    nodeTypes[i / kTypesPerWord] |=
+        static_cast<uint64_t>(nodeType(old)) << (i % kTypesPerWord * 2);
+    const vector<Arc>& arcs = _adjacencyLists[old];
+    vector<Arc>& newArcs = adjacencyLists[i];
+    for (auto arc = arcs.begin(); arc != arcs.end(); ++arc) {
+      const int dest = newIndex[arc->destination()];
+      if (dest != -1)
+        newArcs.push_back(Arc(dest, arc->cost(), arc->penalty(), arc->walk()));
+    }
+    numArcs += newArcs.size();
+  }
+  _nodeStops.swap(nodeStops);
+  _nodeTimes.swap(nodeTimes);
+  _nodeTypes.swap(nodeTypes);
+  _nodeDays.swap(nodeDays);
+  _adjacencyLists.swap(adjacencyLists);
+  _numArcs = numArcs;
+
+  for (size_t i = 0; i < _stops.size(); ++i) {
+    Stop& stop = _stops[i];
+    stop.eraseNodeIndices(std::remove_if(stop.nodesBegin(), stop.nodesEnd(),
+                                         [&newIndex](const int node) {
+                                           return newIndex[node] == -1;
+                                         }));
+    for (auto node = stop.nodesBegin(); node != stop.nodesEnd(); ++node)
+      *node = newIndex[*node];
+  }
+  _stopTimeOffsets.clear();
+  if (stopTimes)
+    buildStopTimes();
+  return oldIndex;
+}
+
+
+TransitNetwork TransitNetwork::mirrored() const {
   TransitNetwork mirrored = *this;
   for (size_t i = 0; i < _adjacencyLists.size(); ++i) {
     for (auto arc = adjacencyList(i).cbegin(); arc != adjacencyList(i).end();
@@ -277,13 +620,16 @@ string TransitNetwork::name() const {
 int TransitNetwork::addTransitNode(const int stopIndex,
                                    const Node::Type& type,
                                    int time) {
-  // add the node, initialize its adjacency list and return its index in _nodes
-  assert(_nodes.size() == _adjacencyLists.size());
+  // add the node, initialize its adjacency list and return its index
+  assert(_nodeStops.size() == _adjacencyLists.size());
   assert(stopIndex >= 0 && stopIndex < static_cast<int>(_stops.size()));
-  const size_t index = _nodes.size();
-  _nodes.push_back(Node(stopIndex, type, time));
-  _adjacencyLists.push_back(vector<Arc>());
+  const size_t index = _nodeStops.size();
+  if (index == 0)
+    _timeEpoch = time;
+  resizeNodes(index + 1);
+  setNode(index, stopIndex, type, time);
   stop(stopIndex).addNodeIndex(index);
+  _stopTimeOffsets.clear();
   return index;
 }
 
@@ -293,6 +639,9 @@ void TransitNetwork::addStop(Stop& stop) {  // NOLINT
   _stopId2indexMap[stop.id()] = _stops.size();
   stop.index(_stops.size());
   _stops.push_back(stop);
+  _stopLats.push_back(stop.lat());
+  _stopLons.push_back(stop.lon());
+  _stopTimeOffsets.clear();
 }
 
 
@@ -304,9 +653,9 @@ void TransitNetwork::addArc(int source, int target, int cost) {
 void TransitNetwork::addArc(int source, int target, int cost, int penalty) {
   assert(cost >= 0);
   assert(penalty >= 0);
-  assert(_adjacencyLists.size() == _nodes.size());
-  assert(source < static_cast<int>(_nodes.size()));
-  assert(target < static_cast<int>(_nodes.size()));
+  assert(_adjacencyLists.size() == numNodes());
+  assert(source < static_cast<int>(numNodes()));
+  assert(target < static_cast<int>(numNodes()));
   _adjacencyLists[source].push_back(Arc(target, cost, penalty));
   _numArcs++;
 }
@@ -328,33 +677,35 @@ const Stop* TransitNetwork::findNearestStop(const float lat,
 
 vector<int> TransitNetwork::findStartNodeSequence(const Stop& stop,
                                                   const int time) const {
-  const int numStopNodes = stop.numNodes();
-  vector<int> nodes;
-  nodes.reserve(numStopNodes * 0.66f);
-  const int startIndex = findFirstNode(stop, time);
-  if (startIndex >= 0) {
-    for (int i = startIndex; i < numStopNodes; ++i) {
-      const int nodeIndex = stop.nodeIndex(i);
-      const int type = _nodes[nodeIndex].type();
-      if (type == Node::DEPARTURE) {
-          nodes.push_back(nodeIndex);
-      } else if (type == Node::TRANSFER) {
-          nodes.push_back(nodeIndex);
-          break;
-      }
-    }
-  }
-  return nodes;
+  const StartNodeRange range = startNodes(stop, time);
+  return vector<int>(range.begin(), range.end());
+}
+
+
+TransitNetwork::StartNodeRange
+TransitNetwork::startNodes(const Stop& stop, const int time) const {
+  return startNodes(stop.index(), time);
+}
+
+
+TransitNetwork::StartNodeRange
+TransitNetwork::startNodes(const int stop, const int time) const {
+  const std::pair<const int*, const int*> nodes = stopNodes(stop);
+  const int* begin = nodes.first + findFirstNode(stop, time);
+  const int* end = nodes.second;
+  const int* last = begin;
+  while (last != end && nodeType(*last) != Node::TRANSFER)
+    ++last;
+  return StartNodeRange(begin, last == end ? end : last + 1, this);
 }
 
 
 const vector<int> TransitNetwork::getDepNodes(const int stopIndex) const {
-  const vector<int> nodeIndices = _stops[stopIndex].getNodeIndices();
+  const std::pair<const int*, const int*> nodes = stopNodes(stopIndex);
   vector<int> depNodes;
-  depNodes.reserve(nodeIndices.size() / 2);
-  for (auto it = nodeIndices.begin(), end = nodeIndices.end();
-       it != end; ++it) {
-    if (_nodes[*it].type() == Node::DEPARTURE)
+  depNodes.reserve((nodes.second - nodes.first) / 2);
+  for (const int* it = nodes.first; it != nodes.second; ++it) {
+    if (nodeType(*it) == Node::DEPARTURE)
       depNodes.push_back(*it);
   }
   return depNodes;
@@ -373,7 +724,7 @@ const GeoInfo& TransitNetwork::geoInfo() const {
 string TransitNetwork::debugString() const {
   std::ostringstream oss;
 
-  oss << "[" << _nodes.size() << "," << _numArcs;
+  oss << "[" << numNodes() << "," << _numArcs;
   if (_adjacencyLists.size()) oss << ",";
   for (size_t i = 0; i < _adjacencyLists.size(); i++) {
     const vector<Arc>& arcs = _adjacencyLists[i];
@@ -407,37 +758,98 @@ string TransitNetwork::debugStringOfWalkingGraph() const {
 
 
 int TransitNetwork::findFirstNode(const Stop& stop, const int ptime) const {
-  // Perform a binary search on the sorted sequence of indices.
-  int lowerLimit = 0;
-  int upperLimit = stop.numNodes();
-  int size = stop.numNodes();
-  int center = -1;
-  while (size > 1) {
-    center = lowerLimit + size / 2;
-    const int centerTime = _nodes[stop.nodeIndex(center)].time();
-    if (ptime < centerTime) {
-      upperLimit = center;
-    } else if (ptime > centerTime) {
-      lowerLimit = center;
-    } else {  // ptime == centerTime
-      lowerLimit = center;
-      break;
+  return findFirstNode(stop.index(), ptime);
+}
+
+
+int TransitNetwork::findFirstNode(const int i, const int ptime) const {
+  assert(i >= 0 && i < static_cast<int>(numStops()));
+  // The nodes of periodic networks are within the first period.
+  const int time = _period ? _timeEpoch + ((ptime - _timeEpoch) % _period +
+                                           _period) % _period
+                           : ptime;
+  if (hasStopTimes()) {
+    const int size = _stopTimeOffsets[i + 1] - _stopTimeOffsets[i];
+    assert(size == _stops[i].numNodes());
+    if (size <= kMaxDirectSearchSize) {
+      const int* times = _stopTimes.data() + _stopTimeOffsets[i];
+      return std::lower_bound(times, times + size, time) - times;
+    }
+    // Descend the Eytzinger tree, the bits of k encode the path taken. The
+    // grandchildren 4 levels below are prefetched, they share a cache line.
+    const int* times = _stopTimeIndex.data() + _stopTimeOffsets[i] + i;
+    unsigned int k = 1;
+    while (k <= static_cast<unsigned int>(size)) {
+      __builtin_prefetch(times + 16 * k);
+      k = 2 * k + (times[k] < time);
     }
-    size = upperLimit - lowerLimit;
+    // Undo the right turns after the last left turn, which went to the first
+    // time not before the searched one.
+    k >>= __builtin_ffs(~k);
+    return k ? _stopTimeRanks[_stopTimeOffsets[i] + i + k] : size;
   }
-  center = lowerLimit;
-  if (stop.numNodes()) {
-    // Go to the left to the first index that corresponds to a node
-    // with time less than PTIME or to the first position of INDICES.
-    // Important for ranges of equal value.
-    while (_nodes[stop.nodeIndex(center)].time() >= ptime && center > 0)
-      center--;
-    // We want the index of the first node with time >= PTIME
-    // so increase CENTER.
-    if (_nodes[stop.nodeIndex(center)].time() < ptime)
-      center++;
+  // The network is being built, search the node times directly.
+  const vector<int>& indices = _stops[i].getNodeIndices();
+  return std::lower_bound(indices.begin(), indices.end(), time,
+                          [this](const int node, const int t) {
+                            return nodeTime(node) < t;
+                          }) - indices.begin();
+}
+
+
+bool TransitNetwork::hasStopTimes() const {
+  return _stopTimeOffsets.size() == _stops.size() + 1;
+}
+
+
+void TransitNetwork::buildStopTimes() {
+  _stopTimeOffsets.assign(1, 0);
+  _stopTimeOffsets.reserve(_stops.size() + 1);
+  for (size_t i = 0; i < _stops.size(); ++i)
+    _stopTimeOffsets.push_back(_stopTimeOffsets.back() + _stops[i].numNodes());
+  _stopNodes.resize(_stopTimeOffsets.back());
+  _stopTimes.resize(_stopTimeOffsets.back());
+  for (size_t i = 0; i < _stops.size(); ++i) {
+    const vector<int>& indices = _stops[i].getNodeIndices();
+    for (size_t k = 0; k < indices.size(); ++k) {
+      _stopNodes[_stopTimeOffsets[i] + k] = indices[k];
+      _stopTimes[_stopTimeOffsets[i] + k] = nodeTime(indices[k]);
+    }
+  }
+  buildStopTimeIndex();
+}
+
+
+void TransitNetwork::buildStopTimeIndex() {
+  const int numStops = _stops.size();
+  assert(static_cast<int>(_stopTimeOffsets.size()) == numStops + 1);
+  _stopTimeIndex.assign(_stopTimes.size() + numStops, 0);
+  _stopTimeRanks.assign(_stopTimes.size() + numStops, -1);
+  #pragma omp parallel for schedule(dynamic, 64)
+  for (int i = 0; i < numStops; ++i) {
+    const int size = _stopTimeOffsets[i + 1] - _stopTimeOffsets[i];
+    if (size <= kMaxDirectSearchSize)
+      continue;
+    const int block = _stopTimeOffsets[i] + i;
+    // An in-order traversal of the implicit tree assigns the sorted times to
+    // the tree positions.
+    int k = 1;
+    while (2 * k <= size)
+      k = 2 * k;
+    for (int rank = 0; rank < size; ++rank) {
+      _stopTimeIndex[block + k] = _stopTimes[_stopTimeOffsets[i] + rank];
+      _stopTimeRanks[block + k] = rank;
+      if (2 * k + 1 <= size) {
+        // Continue with the leftmost node of the right subtree.
+        k = 2 * k + 1;
+        while (2 * k <= size)
+          k = 2 * k;
+      } else {
+        // Go up to the first ancestor whose left subtree is complete.
+        k >>= __builtin_ffs(~k);
+      }
+    }
   }
-  return center;
 }
 
 
@@ -453,40 +865,101 @@ void TransitNetwork::buildKdtreeFromStops() {
 void TransitNetwork::buildWalkingGraph(const float dist) {
   const int numStops_ = numStops();
   assert(numStops_);
-  assert(!_mapOfStops.empty());
   assert(dist >= 0);
   _walkwayLists.clear();
   _walkwayLists.resize(numStops_);
 
+  // Projects the stops to meters, with longitudes scaled for the largest
+  // latitude so that projected distances do not exceed the true ones. Stops
+  // within the distance then lie in neighbouring grid cells.
+  const float degToMeters = 6371000.f * M_PI / 180.f;
+  float maxLat = 0.f;
+  for (int i = 0; i < numStops_; ++i)
+    maxLat = std::max(maxLat, std::fabs(_stopLats[i]));
+  const float lonToMeters =
+      degToMeters * cos(std::min(maxLat, 89.f) * M_PI / 180.f);
+  const float cellSize = dist * 1.01f + 1.f;
+  vector<std::pair<uint64_t, int> > cellStops(numStops_);
   for (int i = 0; i < numStops_; ++i) {
-    // collect all neighbors
-    StopTreeNode reference(_stops[i]);
-    vector<StopTreeNode> results;
-    _mapOfStops.find_within_range(reference, dist,
-                   std::back_insert_iterator<vector<StopTreeNode> >(results));
-
-    const int numResults = results.size();
-    // add arcs to all neighbors, not to the stop itself
-    for (int j = 0; j < numResults; ++j) {
-      const Stop& head = *(results[j].stopPtr);
-      if (head == _stops[i]) {
-        continue;
-      } else {
-        // compute the costs
-        float dlat = _stops[i].lat() - head.lat();
-        float dlon = _stops[i].lon() - head.lon();
-        dlat = dlat * dlat;
-        dlon = dlon * dlon;
-        float d = greatCircleDistance(_stops[i].lat(), _stops[i].lon(),
-                                      head.lat(), head.lon());
-        if (d <= dist) {  // takes care for the kdtree shortcoming
-          int cost = d / (5.f * 1000.f / 60.f / 60.f);  // speed is 5km/h
-          int penalty = 1;
-          _walkwayLists[i].push_back(Arc(head.index(), cost, penalty));
+    const int32_t x = floor(_stopLons[i] * lonToMeters / cellSize);
+    const int32_t y = floor(_stopLats[i] * degToMeters / cellSize);
+    cellStops[i] = std::make_pair(
+        static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32 |
+        static_cast<uint32_t>(y), i);
+  }
+  std::sort(cellStops.begin(), cellStops.end());
+  // The stops ordered by cell with their projected positions, cell c holds
+  // [cellOffsets[c], cellOffsets[c + 1]).
+  vector<uint64_t> cellKeys;
+  vector<int> cellOffsets;
+  vector<int> stops(numStops_);
+  vector<float> xs(numStops_);
+  vector<float> ys(numStops_);
+  for (int k = 0; k < numStops_; ++k) {
+    const int i = cellStops[k].second;
+    if (k == 0 || cellStops[k].first != cellKeys.back()) {
+      cellKeys.push_back(cellStops[k].first);
+      cellOffsets.push_back(k);
+    }
+    stops[k] = i;
+    xs[k] = _stopLons[i] * lonToMeters;
+    ys[k] = _stopLats[i] * degToMeters;
+  }
+  cellOffsets.push_back(numStops_);
+  const int numCells = cellKeys.size();
+  const float maxDist2 = cellSize * cellSize;
+
+  #pragma omp parallel
+  {  // NOLINT
+  vector<float> dist2;
+  #pragma omp for schedule(dynamic, 64)
+  for (int c = 0; c < numCells; ++c) {
+    const uint32_t x = cellKeys[c] >> 32;
+    const uint32_t y = cellKeys[c];
+    for (uint32_t nx = x - 1; nx != x + 2; ++nx) {
+      for (uint32_t ny = y - 1; ny != y + 2; ++ny) {
+        const uint64_t key = static_cast<uint64_t>(nx) << 32 | ny;
+        const auto cell = std::lower_bound(cellKeys.begin(), cellKeys.end(),
+                                           key);
+        if (cell == cellKeys.end() || *cell != key)
+          continue;
+        const int begin = cellOffsets[cell - cellKeys.begin()];
+        const int end = cellOffsets[cell - cellKeys.begin() + 1];
+        dist2.resize(end - begin);
+        for (int k = cellOffsets[c]; k < cellOffsets[c + 1]; ++k) {
+          // Projected distances first, in a loop the compiler vectorizes.
+          for (int l = begin; l < end; ++l) {
+            const float dx = xs[l] - xs[k];
+            const float dy = ys[l] - ys[k];
+            dist2[l - begin] = dx * dx + dy * dy;
+          }
+          const int i = stops[k];
+          for (int l = begin; l < end; ++l) {
+            const int headIndex = stops[l];
+            if (dist2[l - begin] > maxDist2 || headIndex == i)
+              continue;
+            // compute the costs
+            float d = greatCircleDistance(_stopLats[i], _stopLons[i],
+                                          _stopLats[headIndex],
+                                          _stopLons[headIndex]);
+            if (d <= dist) {
+              int cost = d / (5.f * 1000.f / 60.f / 60.f);  // speed is 5km/h
+              int penalty = 1;
+              _walkwayLists[i].push_back(Arc(headIndex, cost, penalty));
+            }
+          }
         }
       }
     }
+    for (int k = cellOffsets[c]; k < cellOffsets[c + 1]; ++k) {
+      vector<Arc>& arcs = _walkwayLists[stops[k]];
+      std::sort(arcs.begin(), arcs.end(), [](const Arc& a, const Arc& b) {
+        return a.destination() < b.destination();
+      });
+    }
   }
+  }  // pragma omp parallel
+  buildWalkCosts();
 
   #ifdef CREATE_WALKWAY_STATISTICS
   // TODO(sawine): move this into its own function, don't clutter up functions.
@@ -534,8 +1007,8 @@ void TransitNetwork::computeGeoInfo() {
   _geoInfo.lonMin = maxFloat;
   _geoInfo.lonMax = -1.0f * maxFloat;
   for (size_t i = 0; i < _stops.size(); ++i) {
-    const float lat = _stops[i].lat();
-    const float lon = _stops[i].lon();
+    const float lat = _stopLats[i];
+    const float lon = _stopLons[i];
     assert(fabs(lat - Stop::kInvalidPos) > kE);
     assert(fabs(lon - Stop::kInvalidPos) > kE);
     _geoInfo.latMin = std::min(_geoInfo.latMin, lat);
@@ -557,18 +1030,42 @@ const vector<Arc>& TransitNetwork::walkwayList(const int stop) const {
 }
 
 
-vector<Arc>
-TransitNetwork::walkway(const int stopFrom, const int stopTo) const {
-  vector<Arc> result;
-  for (auto it = walkwayList(stopFrom).begin(),
-       end = walkwayList(stopFrom).end();
-       it != end; ++it) {
-    if (it->destination() == stopTo) {
-      result.push_back(*it);
-      break;
+void TransitNetwork::buildWalkCosts() {
+  _walkCostOffsets.assign(1, 0);
+  _walkCostOffsets.reserve(_walkwayLists.size() + 1);
+  _walkCostHeads.clear();
+  _walkCosts.clear();
+  vector<std::pair<int, int> > arcs;
+  for (size_t i = 0; i < _walkwayLists.size(); ++i) {
+    arcs.clear();
+    for (auto it = _walkwayLists[i].begin(); it != _walkwayLists[i].end();
+         ++it) {
+      arcs.push_back(std::make_pair(it->destination(), it->cost()));
+    }
+    // Keeps the first of several arcs to the same stop in front.
+    std::stable_sort(arcs.begin(), arcs.end(),
+                     [](const std::pair<int, int>& a,
+                        const std::pair<int, int>& b) {
+                       return a.first < b.first;
+                     });
+    for (auto it = arcs.begin(); it != arcs.end(); ++it) {
+      _walkCostHeads.push_back(it->first);
+      _walkCosts.push_back(it->second);
     }
+    _walkCostOffsets.push_back(_walkCostHeads.size());
   }
-  return result;
+}
+
+
+int TransitNetwork::walkCost(const int stopFrom, const int stopTo) const {
+  assert(stopFrom >= 0 &&
+         static_cast<size_t>(stopFrom) + 1 < _walkCostOffsets.size());
+  const int* begin = _walkCostHeads.data() + _walkCostOffsets[stopFrom];
+  const int* end = _walkCostHeads.data() + _walkCostOffsets[stopFrom + 1];
+  const int* head = std::lower_bound(begin, end, stopTo);
+  if (head == end || *head != stopTo)
+    return INT_MAX;
+  return _walkCosts[head - _walkCostHeads.data()];
 }
 
 const vector<vector<Arc> >& TransitNetwork::adjacencyLists() const {
@@ -581,7 +1078,41 @@ const vector<Arc>& TransitNetwork::adjacencyList(const size_t node) const {
 }
 
 size_t TransitNetwork::numNodes() const {
-  return _nodes.size();
+  return _nodeStops.size();
+}
+
+
+void TransitNetwork::loadNodes(const vector<Node>& nodes) {
+  // The nodes have absolute times, which are their offsets from epoch 0.
+  _nodeStops.clear();
+  _nodeTimes.clear();
+  _nodeTypes.clear();
+  _timeEpoch = 0;
+  _period = 0;
+  resizeNodes(nodes.size());
+  for (size_t i = 0; i < nodes.size(); ++i)
+    setNode(i, nodes[i].stop(), nodes[i].type(), nodes[i].time());
+}
+
+
+void TransitNetwork::loadStopCoordinates() {
+  _stopLats.resize(_stops.size());
+  _stopLons.resize(_stops.size());
+  for (size_t i = 0; i < _stops.size(); ++i) {
+    _stopLats[i] = _stops[i].lat();
+    _stopLons[i] = _stops[i].lon();
+  }
+}
+
+
+void TransitNetwork::resizeNodes(const size_t size) {
+  assert(size >= numNodes());
+  _nodeStops.resize(size, -1);
+  _nodeTimes.resize(size, 0);
+  _nodeTypes.resize((size + kTypesPerWord - 1) / kTypesPerWord, 0);
+  if (_period)
+    _nodeDays.resize(size, 0);
+  _adjacencyLists.resize(size);
 }
 
 size_t TransitNetwork::numArcs() const {
@@ -592,6 +1123,19 @@ size_t TransitNetwork::numStops() const {
   return _stops.size();
 }
 
+std::pair<const int*, const int*>
+TransitNetwork::stopNodes(const int stop) const {
+  assert(stop >= 0 && stop < static_cast<int>(numStops()));
+  if (hasStopTimes()) {
+    const int* nodes = _stopNodes.data();
+    return std::make_pair(nodes + _stopTimeOffsets[stop],
+                          nodes + _stopTimeOffsets[stop + 1]);
+  }
+  const vector<int>& indices = _stops[stop].getNodeIndices();
+  return std::make_pair(indices.data(), indices.data() + indices.size());
+}
+
+
 const Stop& TransitNetwork::stop(const size_t stop) const {
   assert(stop < numStops());
   return _stops.at(stop);
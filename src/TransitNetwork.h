@@ -4,14 +4,19 @@
 
 #include <boost/archive/binary_iarchive.hpp>
 #include <boost/archive/binary_oarchive.hpp>
+#include <boost/serialization/split_member.hpp>
 #include <boost/serialization/vector.hpp>
+#include <boost/serialization/version.hpp>
 #include <google/dense_hash_map>
 #include <kdtree++/kdtree.hpp>
+#include <cassert>
+#include <cstdint>
 #include <ostream>
 #include <vector>
 #include <string>
 #include <functional>
 #include <queue>
+#include <utility>
 #include "gtest/gtest_prod.h"  // Needed for FRIEND_TEST in this case.
 #include "./StopTree.h"
 #include "./GeoInfo.h"
@@ -25,7 +30,8 @@ using std::make_pair;
 using google::dense_hash_map;
 
 
-// Represents a Node in a transit network.
+// Represents a Node in a transit network. The network stores its nodes field by
+// field, Node is the value returned when accessing all fields at once.
 class Node {
  public:
   enum Type {
@@ -50,7 +56,7 @@ class Node {
   // Constructor
   Node()
     : _stop(-1), _type(NONE), _time(-1) {}
-  // serialization / deserialization
+  // deserialization, TransitNetwork archives of version 0 store their nodes
   template<class Archive>
   void serialize(Archive& ar, const unsigned int version) {  //NOLINT
     ar & _stop;
@@ -70,47 +76,45 @@ class Node {
 string type2Str(const Node::Type type);
 
 
-// A functor to compare nodes[a] and nodes[b] for sorting, sorts ascending by
-// time and transfer nodes before departure nodes. This sophisticated structure
-// is used here, because a standard static comparison function cannot access the
-// non-static _nodes array.
-class CompareNodesByTime : std::binary_function<int, int, bool> {
- public:
-  explicit CompareNodesByTime(const vector<Node>* nodes) : _nodes(nodes) {}
-  bool operator() (const int& a, const int& b);
-  const vector<Node>* _nodes;
-};
-
-
-// An arc to a destination node specified by its id with a certain cost.
+// An arc to a destination node specified by its id with a certain cost. Walk
+// arcs are walking transfers to another stop added by addWalkArcs().
 class Arc {
  public:
   Arc(const int dest, const unsigned int cost, const unsigned char penalty)
-    : _dest(dest), _cost(cost), _penalty(penalty) {}
+    : _dest(dest), _cost(cost), _penalty(penalty), _walk(false) {}
+  Arc(const int dest, const unsigned int cost, const unsigned char penalty,
+      const bool walk)
+    : _dest(dest), _cost(cost), _penalty(penalty), _walk(walk) {}
 
   bool operator==(const Arc& rhs) const {
-    return _dest == rhs._dest && _cost == rhs._cost && _penalty == rhs._penalty;
+    return _dest == rhs._dest && _cost == rhs._cost &&
+           _penalty == rhs._penalty && _walk == rhs._walk;
   }
 
   int destination() const { return _dest; }
   unsigned int cost() const { return _cost; }
   unsigned char penalty() const { return _penalty; }
+  bool walk() const { return _walk; }
 
  private:
-  Arc() {}
-  // serialization / deserialization
+  Arc() : _walk(false) {}
+  // serialization / deserialization, version 0 archives have no walk arcs
   template<class Archive>
   void serialize(Archive& ar, const unsigned int version) {  // NOLINT
     ar & _dest;
     ar & _cost;
     ar & _penalty;
+    if (version > 0)
+      ar & _walk;
   }
   friend class boost::serialization::access;
 
   int _dest;
   unsigned int _cost;
   unsigned char _penalty;
+  bool _walk;
 };
+BOOST_CLASS_VERSION(Arc, 1)
 
 
 // The TransitNetwork class. It's a graph.
@@ -121,6 +125,66 @@ class TransitNetwork {
   // The farthest distance between stops that can be walked.
   static const float MAX_WALKWAY_DIST;
 
+  // The start nodes at a stop from a certain time on: its departure nodes up
+  // to and including the next transfer node in time order. Iterates over the
+  // stop's node indices in place.
+  class StartNodeRange {
+   public:
+    class const_iterator {
+     public:
+      typedef std::forward_iterator_tag iterator_category;
+      typedef int value_type;
+      typedef ptrdiff_t difference_type;
+      typedef const int* pointer;
+      typedef const int& reference;
+
+      const_iterator(const int* pos, const int* end,
+                     const TransitNetwork* network)
+        : _pos(pos), _end(end), _network(network) { skip(); }
+      const int& operator*() const { return *_pos; }
+      const_iterator& operator++() {
+        ++_pos;
+        skip();
+        return *this;
+      }
+      bool operator==(const const_iterator& other) const {
+        return _pos == other._pos;
+      }
+      bool operator!=(const const_iterator& other) const {
+        return _pos != other._pos;
+      }
+
+     private:
+      // Skips the nodes that are neither departure nor transfer nodes.
+      void skip() {
+        while (_pos != _end) {
+          const Node::Type type = _network->nodeType(*_pos);
+          if (type == Node::DEPARTURE || type == Node::TRANSFER)
+            break;
+          ++_pos;
+        }
+      }
+
+      const int* _pos;
+      const int* _end;
+      const TransitNetwork* _network;
+    };
+
+    StartNodeRange(const int* begin, const int* end,
+                   const TransitNetwork* network)
+      : _begin(begin), _end(end), _network(network) {}
+    const_iterator begin() const {
+      return const_iterator(_begin, _end, _network);
+    }
+    const_iterator end() const { return const_iterator(_end, _end, _network); }
+    bool empty() const { return begin() == end(); }
+
+   private:
+    const int* _begin;
+    const int* _end;
+    const TransitNetwork* _network;
+  };
+
   // Constructor
   explicit TransitNetwork();
 
@@ -133,6 +197,13 @@ class TransitNetwork {
   // Assignment Operator
   TransitNetwork& operator=(const TransitNetwork& other);
 
+  // Move Constructor and Assignment, leave the other network empty.
+  TransitNetwork(TransitNetwork&& other);
+  TransitNetwork& operator=(TransitNetwork&& other);
+
+  // Returns the number of deep copies of networks made so far.
+  static size_t numCopies();
+
   // Resets the TransitNetwork, clearing all data.
   void reset();
 
@@ -143,6 +214,24 @@ class TransitNetwork {
   // a network. I.e. construct stuff that cannot be serialized.
   void preprocess();
 
+  // Replaces the walking graph by its transitive closure: walkways between
+  // stops connected by walkways of at most maxWalkTime seconds in total, the
+  // direct walkways are kept. Then adds the walking transfers of each arrival
+  // node as walk arcs to the start nodes at the reachable stops, so searches
+  // walk by plain arc relaxations. Call once, after preprocess().
+  void addWalkArcs(const int maxWalkTime);
+
+  // Returns the walking time the walk arcs were added with, 0 if the walking
+  // transfers are left to the searches.
+  int maxWalkTime() const { return _maxWalkTime; }
+
+  // Returns the period of a periodic network, 0 otherwise. A periodic network
+  // has the nodes of each trip once, at their time within the first period,
+  // with the days of the horizon they take place on. The last node of each
+  // stop is a transfer node at the end of the period, which waits for the
+  // nodes of the next period.
+  int period() const { return _period; }
+
   // Creates a compressed, i.e. time independent version of the network: For
   // each stop it has one node and between two nodes there is an arc with cost
   // as the cost of the fastest connection between two arrival and departure of
@@ -152,14 +241,27 @@ class TransitNetwork {
 
   // Creates a mirrored version of the network: For each arc, there is an arc of
   // opposite direction and equal cost. Used to determine connected components.
-  const TransitNetwork mirrored() const;
+  TransitNetwork mirrored() const;
 
   // Returns the largest connected component if we consider the network as bi-
   // directional graph. NOTE(jonas): Right now, the component has the same arcs
   // and nodes as the original network. Just the stops are filtered.
-  const TransitNetwork largestConnectedComponent() const;
+  TransitNetwork largestConnectedComponent() const;
   FRIEND_TEST(TransitNetworkTest, largestConnectedComponent);
 
+  // Renumbers the nodes for memory locality of searches: the stops are ordered
+  // breadth-first along the arcs and the nodes of each stop get consecutive
+  // indices in the order of its node list, i.e. by time. Returns the old index
+  // of each node.
+  vector<int> renumberNodes();
+
+  // Removes the nodes that are on no optimal path: arrival nodes without
+  // incoming arcs, i.e. at the first stop of a trip, and departure nodes
+  // without outgoing arcs, i.e. at the last stop, unless they are after the
+  // last transfer node of their stop, where walking to the stop ends on them.
+  // The other nodes keep their order. Returns the old index of each node.
+  vector<int> reduce();
+
   // Sets the network name.
   void name(const string& name);
 
@@ -175,8 +277,45 @@ class TransitNetwork {
   // Returns the number of stops.
   size_t numStops() const;
 
-  // Returns node reference for given node index.
-  inline const Node& node(const size_t node) const { return _nodes.at(node); }
+  // Returns the node with given node index.
+  Node node(const size_t node) const {
+    return Node(nodeStop(node), nodeType(node), nodeTime(node));
+  }
+
+  // Return single fields of the node with given index. Unchecked unless
+  // assertions are enabled.
+  int nodeStop(const size_t node) const {
+    assert(node < _nodeStops.size());
+    return _nodeStops[node];
+  }
+  int nodeTime(const size_t node) const {
+    assert(node < _nodeTimes.size());
+    return static_cast<int>(static_cast<uint32_t>(_timeEpoch) +
+                            static_cast<uint32_t>(_nodeTimes[node]));
+  }
+  Node::Type nodeType(const size_t node) const {
+    assert(node < _nodeStops.size());
+    return static_cast<Node::Type>(
+        (_nodeTypes[node / kTypesPerWord] >> (node % kTypesPerWord * 2)) & 3);
+  }
+
+  // Returns whether the node takes place on the given day, counted from the
+  // first day of the network. Nodes of aperiodic networks always do.
+  bool runs(const size_t node, const int day) const {
+    if (!_period)
+      return true;
+    assert(node < _nodeDays.size());
+    return day >= 0 && day < 64 && ((_nodeDays[node] >> day) & 1);
+  }
+
+  // Returns the time from the given time to the node, in periodic networks to
+  // its next occurrence.
+  int waitTime(const int time, const size_t node) const {
+    const int wait = nodeTime(node) - time;
+    if (!_period)
+      return wait;
+    return (wait % _period + _period) % _period;
+  }
 
   // Returns a reference to the vector of adjacency lists.
   const vector<vector<Arc> >& adjacencyLists() const;
@@ -190,6 +329,21 @@ class TransitNetwork {
   // Returns stop reference for given stop index.  TODO(sawine): unsafe.
   Stop& stop(const size_t stop);
 
+  // Returns the coordinates of the stop with given index without touching its
+  // display data.
+  float stopLat(const size_t stop) const {
+    assert(stop < _stopLats.size());
+    return _stopLats[stop];
+  }
+  float stopLon(const size_t stop) const {
+    assert(stop < _stopLons.size());
+    return _stopLons[stop];
+  }
+
+  // Returns the node indices of the stop with given index in the order of its
+  // node list, i.e. by time once the network is preprocessed.
+  std::pair<const int*, const int*> stopNodes(const int stop) const;
+
   // Accesses the walking graph
   const vector<vector<Arc> >& walkingGraph() const;
 
@@ -197,14 +351,14 @@ class TransitNetwork {
   // elements are the arcs starting at stop i.
   const vector<Arc>& walkwayList(const int i) const;
 
-  // Get the walking arc between two stops. Result is empty, when there is no
-  // such arc and contains the single arc otherwise.
-  vector<Arc> walkway(const int stopFrom, const int stopTo) const;
+  // Returns the cost of the walking arc between two stops or INT_MAX if there
+  // is no such arc. Available once the network is preprocessed.
+  int walkCost(const int stopFrom, const int stopTo) const;
 
   // Returns a reference to the KDTree of stops.
   const StopTree& stopTree() const;
 
-  // Adds a new node, returns its index in the _nodes vector.
+  // Adds a new node, returns its index.
   int addTransitNode(const int stopIndex, const Node::Type& type,
                      int time);
 
@@ -223,6 +377,11 @@ class TransitNetwork {
   // Returns suitable start nodes for given stop and time.
   vector<int> findStartNodeSequence(const Stop& stop, const int ptime) const;
 
+  // Returns the start nodes for given stop and time without copying them.
+  // The range is valid until nodes are added to the stop.
+  StartNodeRange startNodes(const Stop& stop, const int time) const;
+  StartNodeRange startNodes(const int stop, const int time) const;
+
   // Returns all dep Nodes of the given stop
   const vector<int> getDepNodes(const int stopIndex) const;
 
@@ -241,17 +400,39 @@ class TransitNetwork {
   // For a certain STOP returns the position in stop.nodeIndices i for the first
   // node after TIME.
   int findFirstNode(const Stop& stop, const int time) const;
+  int findFirstNode(const int stop, const int time) const;
   FRIEND_TEST(TransitNetworkTest, findFirstNode);
 
+  // Returns whether the per-stop time arrays match the current nodes.
+  bool hasStopTimes() const;
+  FRIEND_TEST(GtfsParserTest, generateInterTripArcs);
+
+  // Collects the node indices and times of each stop in the order of its node
+  // list and builds the search index over them.
+  void buildStopTimes();
+
+  // Builds the walking arcs by head stop from the walkway lists.
+  void buildWalkCosts();
+  FRIEND_TEST(TransitNetworkTest, findFirstNodeIndex);
+
+  // Builds the Eytzinger layout search index over the per-stop times.
+  void buildStopTimeIndex();
+
   // Constructs the kdtree from the vector of stops.
   void buildKdtreeFromStops();
 
+  // Returns the transitive closure of the walkways from the given stop up to
+  // the walking time in the order of the head stops.
+  vector<Arc> closedWalkways(const int stop, const int maxWalkTime) const;
+  FRIEND_TEST(TransitNetworkTest, addWalkArcs);
+
   // Constructs the graph of walking arcs between stops. Retrieves the neighbors
   // within a certain distance (in meters) for all stops and adds arcs to those
   // with costs according to the manhattan distance.
   void buildWalkingGraph(const float dist);
   FRIEND_TEST(GtfsParserTest, walkingGraphConstruction);
   FRIEND_TEST(GtfsParserTest, walkingGraphNonReflexive);
+  FRIEND_TEST(TransitNetworkTest, buildWalkingGraph);
 
   // Computes geometric information about the network: center, min, max
   void computeGeoInfo();
@@ -261,13 +442,66 @@ class TransitNetwork {
   // time-compressed networks to determine connected components.
   vector<size_t> connectedComponentNodes(size_t startNode) const;
 
-  vector<Node> _nodes;
+  // Resizes the node arrays, new nodes have type NONE.
+  void resizeNodes(const size_t numNodes);
+
+  // Sets the fields of a node with type NONE. Different nodes can be set
+  // concurrently.
+  void setNode(const size_t node, const int stopIndex, const Node::Type type,
+               const int time) {
+    assert(nodeType(node) == Node::NONE);
+    _nodeStops[node] = stopIndex;
+    _nodeTimes[node] = static_cast<int32_t>(static_cast<uint32_t>(time) -
+                                            static_cast<uint32_t>(_timeEpoch));
+    // Neighbouring nodes share the type word.
+    __sync_fetch_and_or(&_nodeTypes[node / kTypesPerWord],
+                        static_cast<uint64_t>(type) <<
+                        (node % kTypesPerWord * 2));
+  }
+
+  static const size_t kTypesPerWord = 32;
+
+  // The nodes as structure of arrays: stop indices, times as offsets from
+  // _timeEpoch (the time of the first node) and types packed to 2 bits.
+  vector<int> _nodeStops;
+  vector<int32_t> _nodeTimes;
+  vector<uint64_t> _nodeTypes;
+  int _timeEpoch;
   vector<vector<Arc> > _adjacencyLists;
   size_t _numArcs;
 
+  // The stops with their display data. Searches use the compact per-stop
+  // arrays below.
   vector<Stop> _stops;
+  vector<float> _stopLats;
+  vector<float> _stopLons;
+  // The node indices of each stop in the order of its node list and their
+  // times, those of stop i are at [_stopTimeOffsets[i], _stopTimeOffsets[i+1]).
+  // Built along with the inter-trip arcs or by preprocess and cleared when
+  // nodes or stops are added.
+  vector<int> _stopNodes;
+  vector<int> _stopTimes;
+  vector<int> _stopTimeOffsets;
+  // The per-stop times in Eytzinger layout for cache friendly binary search.
+  // The block of stop i starts at _stopTimeOffsets[i] + i, its position 0 is
+  // unused and position k has the children 2k and 2k + 1. _stopTimeRanks has
+  // the index of each entry in the stop's sorted times.
+  vector<int> _stopTimeIndex;
+  vector<int> _stopTimeRanks;
   // Walking arcs between stops.
   vector<vector<Arc> > _walkwayLists;
+  // The walking arcs by their head stop for walkCost(), those of stop i are at
+  // [_walkCostOffsets[i], _walkCostOffsets[i+1]). Built with the walking graph
+  // or by preprocess.
+  vector<int> _walkCostHeads;
+  vector<int> _walkCosts;
+  vector<int> _walkCostOffsets;
+  // The walking time of the walk arcs, 0 if there are none.
+  int _maxWalkTime;
+  // The period of a periodic network, 0 otherwise, and the days each node
+  // takes place on. Bit i stands for day i from _timeEpoch on.
+  int _period;
+  vector<uint64_t> _nodeDays;
   // A (2-)Kdtree to locate the nearest stop to a certain lat-lon-coordinate.
   StopTree _mapOfStops;
   // Geometric information on the network.
@@ -276,22 +510,73 @@ class TransitNetwork {
   dense_hash_map<string, int> _stopId2indexMap;
   string _name;
 
+  // Counts the deep copies for numCopies().
+  static size_t _numCopies;
+
   // serialization / deserialization: add new members to the archive using '&'
   // cannot serialize the kd tree, reconstruct it after deserialization
+  // Version 0 archives store the nodes as vector<Node>, version 1 stores the
+  // node arrays, the stop coordinates and the walking time of walk arcs and
+  // version 2 adds the period and node days. Version 3 takes the stop
+  // coordinates from the stops instead.
   template<class Archive>
-  void serialize(Archive& ar, const unsigned int version) {  // NOLINT
-    ar & _nodes;
+  void save(Archive& ar, const unsigned int version) const {  // NOLINT
+    ar & _nodeStops;
+    ar & _nodeTimes;
+    ar & _nodeTypes;
+    ar & _timeEpoch;
     ar & _adjacencyLists;
     ar & _numArcs;
     ar & _stops;
     ar & _walkwayLists;
+    ar & _maxWalkTime;
+    ar & _period;
+    ar & _nodeDays;
 //     ar & _stopId2indexMap;  // <-- not serializeable
     ar & _name;
   }
+  template<class Archive>
+  void load(Archive& ar, const unsigned int version) {  // NOLINT
+    if (version == 0) {
+      vector<Node> nodes;
+      ar & nodes;
+      loadNodes(nodes);
+    } else {
+      ar & _nodeStops;
+      ar & _nodeTimes;
+      ar & _nodeTypes;
+      ar & _timeEpoch;
+    }
+    ar & _adjacencyLists;
+    ar & _numArcs;
+    ar & _stops;
+    if (version == 1 || version == 2) {
+      vector<float> coordinates;
+      ar & coordinates;
+      ar & coordinates;
+    }
+    loadStopCoordinates();
+    ar & _walkwayLists;
+    // Networks of version 0 have no walk arcs.
+    _maxWalkTime = 0;
+    if (version > 0)
+      ar & _maxWalkTime;
+    if (version > 1) {
+      ar & _period;
+      ar & _nodeDays;
+    }
+    ar & _name;
+  }
+  BOOST_SERIALIZATION_SPLIT_MEMBER()
+  // Sets the node arrays from the nodes of a version 0 archive.
+  void loadNodes(const vector<Node>& nodes);
+  // Sets the stop coordinate arrays from the stops.
+  void loadStopCoordinates();
   FRIEND_TEST(GtfsParserTest, serialization);
   friend class boost::serialization::access;
   friend class GtfsParser;
 };
+BOOST_CLASS_VERSION(TransitNetwork, 3)
 
 
 #endif  // SRC_TRANSITNETWORK_H_
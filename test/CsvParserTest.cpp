@@ -71,3 +71,39 @@ TEST(CsvParserTest, readNextLine) {
   ASSERT_EQ(0, cp.getNumColumns());
   cp.closeFile();
 }
+
+// _____________________________________________________________________________
+TEST(CsvParserTest, quotedFields) {
+  string testFileName = tmpDir + "/CsvParserTest.TMP.csv";
+  std::ofstream file;
+  file.open(testFileName.c_str());
+  file << "stop_id,stop_name\r\n"
+       << "A,\"Main St, North\"\r\n"
+       << "\"B\",\"The \"\"Old\"\" Mill\"\r\n"
+       << "C,\"Two\nLines\"\r\n"
+       << "D,no end";
+  file.close();
+
+  CsvParser cp;
+  cp.openFile(testFileName.c_str());
+  ASSERT_EQ(2, cp.getNumColumns());
+  EXPECT_EQ("stop_name", string(cp.getItem(1)));
+  cp.readNextLine();
+  ASSERT_EQ(2, cp.getNumColumns());
+  EXPECT_TRUE(cp.field(0) == "A");
+  EXPECT_EQ("Main St, North", cp.field(1).str());
+  cp.readNextLine();
+  ASSERT_EQ(2, cp.getNumColumns());
+  EXPECT_EQ("B", string(cp.getItem(0)));
+  EXPECT_EQ("The \"Old\" Mill", cp.field(1).str());
+  EXPECT_EQ("The \"Old\" Mill", string(cp.getItem(1)));
+  cp.readNextLine();
+  ASSERT_EQ(2, cp.getNumColumns());
+  EXPECT_EQ("Two\nLines", cp.field(1).str());
+  ASSERT_FALSE(cp.eof());
+  cp.readNextLine();
+  ASSERT_TRUE(cp.eof());
+  ASSERT_EQ(2, cp.getNumColumns());
+  EXPECT_EQ("no end", cp.field(1).str());
+  cp.closeFile();
+}
@@ -1,12 +1,16 @@
 // Copyright 2011: Eugen Sawin, Philip Stahl, Jonas Sternisko
 #include <gmock/gmock.h>
+#include <algorithm>
 #include <iostream>
 #include <set>
+#include <tuple>
+#include <utility>
 #include <vector>
 #include "./GtestUtil.h"
 #include "../src/Dijkstra.h"
 #include "../src/Utilities.h"
 #include "../src/GtfsParser.h"
+#include "../src/Random.h"
 #include "../src/TransferPatternRouter.h"
 
 using std::cout;
@@ -1089,6 +1093,38 @@ TEST_F(DijkstraTest, limitedSearchToHubs) {
   EXPECT_EQ(0, result.matrix.at(n4d).size());
 }
 
+TEST_F(DijkstraTest, specializedSearches) {
+  GtfsParser parser;
+  parser.logger(&LOG);
+  LOG.enabled(false);
+  TransitNetwork network = parser.createTransitNetwork(
+      "test/data/walk-test-case3/", "20120118T000000", "20120119T000000");
+  network.preprocess();
+  HubSet hubs = {network.stopIndex("W")};
+  const int destStops[] = {INT_MAX, network.stopIndex("Z")};
+  for (int h = 0; h < 2; ++h) {
+    for (int d = 0; d < 2; ++d) {
+      Dijkstra dijkstra(network);
+      dijkstra.maxPenalty(3);
+      if (h)
+        dijkstra.hubs(&hubs);
+      QueryResult results[2];
+      for (int s = 0; s < 2; ++s) {
+        dijkstra.specialize(s);
+        dijkstra.findShortestPath(
+            network.getDepNodes(network.stopIndex("F")), destStops[d],
+            &results[s]);
+      }
+      EXPECT_EQ(results[0].numSettledLabels, results[1].numSettledLabels);
+      EXPECT_EQ(results[0].destLabels.size(), results[1].destLabels.size());
+      ASSERT_EQ(results[0].matrix.size(), results[1].matrix.size());
+      for (int i = 0; i < results[0].matrix.size(); ++i)
+        EXPECT_EQ(results[0].matrix.at(i).size(),
+                  results[1].matrix.at(i).size());
+    }
+  }
+}
+
 
 /*
 
@@ -1227,3 +1263,228 @@ TEST_F(DijkstraTest, getTransferPatterns) {
                    network.stopIndex("B"), network.stopIndex("Z")};
   EXPECT_EQ(expectedStops, shortestPathStops);
 }
+
+TEST_F(DijkstraTest, walkArcs) {
+  // Stop a reaches c only by walking over b, the walk arcs have this walk.
+  TransitNetwork network;
+  Stop a("a", "a", 48.0000, 7.800);
+  Stop b("b", "b", 48.0007, 7.800);
+  Stop c("c", "c", 48.0014, 7.800);
+  Stop d("d", "d", 49.0000, 7.800);
+  Stop e("e", "e", 50.0000, 7.800);
+  network.addStop(a);
+  network.addStop(b);
+  network.addStop(c);
+  network.addStop(d);
+  network.addStop(e);
+  const int dep = network.addTransitNode(3, Node::DEPARTURE, 0);
+  const int arr = network.addTransitNode(0, Node::ARRIVAL, 1000);
+  network.addTransitNode(1, Node::TRANSFER, 2000);
+  const int dep2 = network.addTransitNode(2, Node::DEPARTURE, 1300);
+  network.addTransitNode(2, Node::TRANSFER, 1350);
+  const int arr2 = network.addTransitNode(4, Node::ARRIVAL, 2000);
+  network.addArc(dep, arr, 1000);
+  network.addArc(dep2, arr2, 700);
+  network.preprocess();
+  const int walkTime = network.walkCost(0, 1) + network.walkCost(1, 2);
+
+  Dijkstra dijkstra(network);
+  dijkstra.logger(&log);
+  QueryResult result;
+  dijkstra.findShortestPath(vector<int>(1, dep), 4, &result);
+  EXPECT_EQ(0, result.destLabels.size());
+
+  TransitNetwork walkNetwork = network;
+  walkNetwork.addWalkArcs(walkTime);
+  Dijkstra walkDijkstra(walkNetwork);
+  walkDijkstra.logger(&log);
+  walkDijkstra.findShortestPath(vector<int>(1, dep), 4, &result);
+  EXPECT_EQ(2000, result.optimalCosts());
+  EXPECT_EQ(1, result.optimalPenalty());
+  // The walked to destination is reached after the walking time.
+  walkDijkstra.findShortestPath(vector<int>(1, dep), 2, &result);
+  EXPECT_EQ(1000 + walkTime, result.optimalCosts());
+  walkDijkstra.findShortestPath(vector<int>(1, dep), INT_MAX, &result);
+  EXPECT_TRUE(result.matrix.contains(arr2, 1));
+}
+
+// Builds a random network the way the parser does: trips over random stops
+// with an arrival, a departure and a transfer node per stop event, the arcs
+// along the trips and the chains of transfer nodes. Neighbouring stops are in
+// walking distance.
+TransitNetwork randomNetwork(const int numStops, const int numTrips,
+                             const int seed) {
+  TransitNetwork network;
+  for (int i = 0; i < numStops; ++i) {
+    Stop stop(convert<string>(i), "", 48.f + 0.0006f * i, 7.8f);
+    network.addStop(stop);
+  }
+  RandomGen random(0, 1 << 20, seed);
+  // The nodes as (stop, time, rank, event node), the parser orders transfer
+  // nodes first. Event node 3k is the arrival of stop event k, 3k + 1 its
+  // departure and 3k + 2 its transfer node.
+  vector<std::tuple<int, int, int, int> > nodes;
+  vector<int> tripEnds;
+  for (int t = 0; t < numTrips; ++t) {
+    int time = random.next() % (4 * 60 * 60);
+    int stop = random.next() % numStops;
+    const int length = 2 + random.next() % 5;
+    for (int k = 0; k < length; ++k) {
+      const int event = nodes.size() / 3;
+      const int dwell = random.next() % 3 * 60;
+      nodes.push_back(std::make_tuple(stop, time, 1, 3 * event));
+      nodes.push_back(std::make_tuple(stop, time + dwell, 2, 3 * event + 1));
+      nodes.push_back(std::make_tuple(
+          stop, time + TransitNetwork::TRANSFER_BUFFER, 0, 3 * event + 2));
+      time += dwell + 60 + random.next() % (15 * 60);
+      stop = (stop + 1 + random.next() % (numStops - 1)) % numStops;
+    }
+    tripEnds.push_back(nodes.size() / 3);
+  }
+  vector<std::tuple<int, int, int, int> > sorted = nodes;
+  std::sort(sorted.begin(), sorted.end());
+  vector<int> eventNodes(nodes.size());
+  const Node::Type types[] = {Node::ARRIVAL, Node::DEPARTURE, Node::TRANSFER};
+  for (auto it = sorted.begin(); it != sorted.end(); ++it) {
+    const int event = std::get<3>(*it);
+    eventNodes[event] = network.addTransitNode(std::get<0>(*it),
+                                               types[event % 3],
+                                               std::get<1>(*it));
+  }
+  int event = 0;
+  for (auto end = tripEnds.begin(); end != tripEnds.end(); ++end) {
+    for (; event < *end; ++event) {
+      const int arrival = eventNodes[3 * event];
+      const int departure = eventNodes[3 * event + 1];
+      network.addArc(arrival, departure,
+                     network.nodeTime(departure) - network.nodeTime(arrival));
+      network.addArc(arrival, eventNodes[3 * event + 2],
+                     TransitNetwork::TRANSFER_BUFFER, 1);
+      if (event + 1 < *end) {
+        const int next = eventNodes[3 * (event + 1)];
+        network.addArc(departure, next,
+                       network.nodeTime(next) - network.nodeTime(departure));
+      }
+    }
+  }
+  for (int i = 0; i < numStops; ++i) {
+    const vector<int>& stopNodes = network.stop(i).getNodeIndices();
+    for (size_t k = 0; k < stopNodes.size(); ++k) {
+      if (network.nodeType(stopNodes[k]) != Node::TRANSFER)
+        continue;
+      for (size_t j = k + 1; j < stopNodes.size(); ++j) {
+        const Node::Type type = network.nodeType(stopNodes[j]);
+        if (type == Node::ARRIVAL)
+          continue;
+        network.addArc(stopNodes[k], stopNodes[j],
+                       network.nodeTime(stopNodes[j]) -
+                       network.nodeTime(stopNodes[k]));
+        if (type == Node::TRANSFER)
+          break;
+      }
+    }
+  }
+  return network;
+}
+
+// Returns the (cost, penalty) pairs of the labels.
+set<std::pair<int, int> > costs(const LabelVec& labels) {
+  set<std::pair<int, int> > costs;
+  for (auto it = labels.begin(); it != labels.end(); ++it)
+    costs.insert(std::make_pair((*it).cost(), (*it).penalty()));
+  return costs;
+}
+
+TEST_F(DijkstraTest, reducedNetwork) {
+  // Searches on the reduced network find the same labels at the remaining
+  // nodes and the same optimal paths as on the original network.
+  const int numStops = 30;
+  TransitNetwork network = randomNetwork(numStops, 300, 3);
+  network.preprocess();
+  TransitNetwork reduced = network;
+  const vector<int> oldIndex = reduced.reduce();
+  ASSERT_EQ(reduced.numNodes(), oldIndex.size());
+  EXPECT_LT(reduced.numNodes(), network.numNodes());
+  EXPECT_LT(reduced.numArcs(), network.numArcs());
+  reduced.validate();
+
+  Dijkstra dijkstra(network);
+  Dijkstra reducedDijkstra(reduced);
+  dijkstra.logger(&log);
+  reducedDijkstra.logger(&log);
+  QueryResult result;
+  QueryResult reducedResult;
+  for (int stop = 0; stop < numStops; ++stop) {
+    dijkstra.findShortestPath(network.getDepNodes(stop), INT_MAX, &result);
+    reducedDijkstra.findShortestPath(reduced.getDepNodes(stop), INT_MAX,
+                                     &reducedResult);
+    for (size_t i = 0; i < reduced.numNodes(); ++i) {
+      ASSERT_EQ(costs(result.matrix.at(oldIndex[i])),
+                costs(reducedResult.matrix.at(i)));
+    }
+
+    const int time = 60 * 60 + stop * 5 * 60;
+    const int destStop = (stop * 7 + 3) % numStops;
+    if (destStop == stop)
+      continue;
+    Dijkstra query(network);
+    Dijkstra reducedQuery(reduced);
+    query.logger(&log);
+    reducedQuery.logger(&log);
+    query.startTime(time);
+    reducedQuery.startTime(time);
+    query.findShortestPath(network.findStartNodeSequence(network.stop(stop),
+                                                         time),
+                           destStop, &result);
+    reducedQuery.findShortestPath(
+        reduced.findStartNodeSequence(reduced.stop(stop), time), destStop,
+        &reducedResult);
+    EXPECT_EQ(costs(result.destLabels), costs(reducedResult.destLabels));
+  }
+}
+
+TEST_F(DijkstraTest, landmarks) {
+  // Searches directed by the landmarks find the same optimal paths as the
+  // undirected searches and settle fewer labels.
+  const int numStops = 40;
+  TransitNetwork network = randomNetwork(numStops, 400, 4);
+  network.preprocess();
+  TransferPatternRouter router(network);
+  router.prepare(vector<Line>());
+  const Landmarks& landmarks = router.landmarks();
+  ASSERT_EQ(TransferPatternRouter::NUM_LANDMARKS, landmarks.size());
+  HubSet hubs = {3, 17};
+
+  size_t numSettled = 0;
+  size_t numSettledAlt = 0;
+  QueryResult result;
+  QueryResult altResult;
+  for (int stop = 0; stop < numStops; ++stop) {
+    for (int i = 1; i < 4; ++i) {
+      const int time = 30 * 60 + i * stop * 2 * 60;
+      const int destStop = (stop * 7 + i * 11) % numStops;
+      if (destStop == stop)
+        continue;
+      Dijkstra dijkstra(network);
+      Dijkstra alt(network);
+      dijkstra.logger(&log);
+      alt.logger(&log);
+      dijkstra.startTime(time);
+      alt.startTime(time);
+      alt.landmarks(&landmarks);
+      if (i == 3) {
+        dijkstra.hubs(&hubs);
+        alt.hubs(&hubs);
+      }
+      const vector<int> depNodes =
+          network.findStartNodeSequence(network.stop(stop), time);
+      dijkstra.findShortestPath(depNodes, destStop, &result);
+      alt.findShortestPath(depNodes, destStop, &altResult);
+      EXPECT_EQ(costs(result.destLabels), costs(altResult.destLabels))
+          << stop << " " << destStop << " " << time;
+      numSettled += result.numSettledLabels;
+      numSettledAlt += altResult.numSettledLabels;
+    }
+  }
+  EXPECT_LT(numSettledAlt, numSettled);
+}
@@ -358,6 +358,41 @@ TEST_F(DirectConnectionTest, zeroConnections) {
   EXPECT_EQ(DirectConnection::INFINITE, dc.query(0, 810, 5));
 }
 
+TEST_F(DirectConnectionTest, frequency) {
+  // A trip 7 -> 8 -> 9 departing at 100 and then every 60 seconds until 340
+  // and a single trip on the same line departing at 130.
+  Trip frequent;
+  frequent.addStop(100, 100, 7);
+  frequent.addStop(150, 160, 8);
+  frequent.addStop(200, 200, 9);
+  frequent.frequency(60, 5);
+  Trip single;
+  single.addStop(130, 130, 7);
+  single.addStop(180, 190, 8);
+  single.addStop(230, 230, 9);
+  vector<Trip> trips;
+  trips.push_back(frequent);
+  trips.push_back(single);
+  vector<Line> lines = LineFactory::createLines(trips);
+  ASSERT_EQ(1, lines.size());
+  DirectConnection dc(10, lines);
+
+  EXPECT_EQ(100, dc.nextDepartureTime(7, 0, 9));
+  EXPECT_EQ(200, dc.query(7, 0, 9));
+  EXPECT_EQ(130, dc.nextDepartureTime(7, 101, 9));
+  EXPECT_EQ(129, dc.query(7, 101, 9));
+  EXPECT_EQ(160, dc.nextDepartureTime(7, 131, 9));
+  EXPECT_EQ(129, dc.query(7, 131, 9));
+  EXPECT_EQ(340, dc.nextDepartureTime(7, 340, 9));
+  EXPECT_EQ(100, dc.query(7, 340, 9));
+  EXPECT_EQ(DirectConnection::INFINITE, dc.nextDepartureTime(7, 341, 9));
+  EXPECT_EQ(DirectConnection::INFINITE, dc.query(7, 341, 8));
+  EXPECT_EQ(190, dc.nextDepartureTime(8, 161, 9));
+  EXPECT_EQ(69, dc.query(8, 161, 9));
+  EXPECT_EQ(220, dc.nextDepartureTime(8, 191, 9));
+  EXPECT_EQ(DirectConnection::INFINITE, dc.query(9, 0, 7));
+}
+
 TEST_F(DirectConnectionTest, queryPerf1M) {
   vector<Trip> trips;
   LineFactory::createTrips(times, stops, &trips);
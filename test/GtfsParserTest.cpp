@@ -1,13 +1,20 @@
 // Copyright 2011: Eugen Sawin, Philip Stahl, Jonas Sternisko
+#include <sys/stat.h>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <google/dense_hash_set>
 #include <google/dense_hash_map>
+#include <fstream>
 #include <ostream>
 #include <map>
+#include <set>
 #include <string>
+#include <utility>
 #include <vector>
 #include "./GtestUtil.h"
+#include "../src/Dijkstra.h"
+#include "../src/DirectConnection.h"
 #include "../src/GtfsParser_impl.h"
+#include "../src/TransferPatternRouter.h"
 #include "../src/TransitNetwork.h"
 #include "../src/Line.h"
 #include "../src/Logger.h"
@@ -27,8 +34,8 @@ class GtfsParserTest : public ::testing::Test {
  public:
   GtfsParser parser;
   Logger test_logger;
-  GtfsParser::ActivityMap serviceActivity;
-  map<string, string> trip2Service;
+  GtfsParser::ServiceCalendar calendar;
+  vector<int> trip2Service;
   dense_hash_map<string, int> stopId2index;
   GtfsParser::FrequencyMap frequencies;
   vector<Stop> stops;
@@ -36,10 +43,8 @@ class GtfsParserTest : public ::testing::Test {
 
   // Prepares the fixture object. Could be in Constructor as well.
   void SetUp() {
-    serviceActivity.set_empty_key("");
-//     trip2Service.set_empty_key("");
     stopId2index.set_empty_key("");
-    frequencies.set_empty_key("");
+    frequencies.set_empty_key(-1);
     test_logger.target("log/test.log");
     parser.logger(&test_logger);
     simple_network_two_days =
@@ -49,6 +54,17 @@ class GtfsParserTest : public ::testing::Test {
 
   // Finishes the usage of the fixture object. Could be in Destructor as well.
   void TearDown() {}
+
+  // Returns the number of days since 1970-01-01 of an ISO date string.
+  static int day(const string& isoDate) {
+    return (from_iso_string(isoDate + "T000000").date() -
+            boost::gregorian::date(1970, 1, 1)).days();
+  }
+
+  // Returns the service of the trip with given GTFS id.
+  int service(const string& tripId) const {
+    return trip2Service[parser.data().lastTripIds.find(tripId)];
+  }
 };
 
 // The Tests go below.
@@ -80,16 +96,24 @@ TEST_F(GtfsParserTest, calendar_txt) {
           "WE,0,0,0,0,0,1,1,20070101,20121231\n");
   fclose(file);
 
-  serviceActivity = parser.parseCalendarFile(filename.c_str());
-  ASSERT_TRUE(contains(serviceActivity, string("FULLW")));
-  for (size_t i = 0; i < 7; ++i)
-    EXPECT_TRUE(serviceActivity["FULLW"].get<0>()[i]);
-  EXPECT_EQ(20070101, serviceActivity["FULLW"].get<1>());
-  EXPECT_EQ(20121231, serviceActivity["FULLW"].get<2>());
-
-  ASSERT_TRUE(contains(serviceActivity, string("WE")));
+  calendar = parser.parseCalendarFile(filename.c_str());
+  ASSERT_EQ(2, calendar.size());
+  const IdMap& serviceIds = parser.data().lastServiceIds;
+  const int fullw = serviceIds.find("FULLW");
+  ASSERT_NE(-1, fullw);
+  EXPECT_EQ(day("20070101"), calendar[fullw].firstDay);
+  EXPECT_EQ(day("20121231") - day("20070101") + 1,
+            calendar[fullw].days.size());
+  EXPECT_TRUE(calendar[fullw].days.all());
+
+  // 2007-01-01 was a monday.
+  const int we = serviceIds.find("WE");
+  ASSERT_NE(-1, we);
   for (size_t i = 0; i < 5; ++i)
-    EXPECT_FALSE(serviceActivity["WE"].get<0>()[i]);
+    EXPECT_FALSE(calendar[we].days[i]);
+  EXPECT_TRUE(calendar[we].days[5]);
+  EXPECT_TRUE(calendar[we].days[6]);
+  EXPECT_FALSE(calendar[we].days[7]);
 }
 
 // _____________________________________________________________________________
@@ -116,30 +140,34 @@ TEST_F(GtfsParserTest, trips_txt) {
 
 
   trip2Service = parser.parseTripsFile(filename.c_str());
-  EXPECT_EQ("FULLW", trip2Service["AB1"]);
-  EXPECT_EQ("FULLW", trip2Service["AB2"]);
-  EXPECT_EQ("FULLW", trip2Service["STBA"]);
-  EXPECT_EQ("FULLW", trip2Service["CITY1"]);
-  EXPECT_EQ("FULLW", trip2Service["CITY2"]);
-  EXPECT_EQ("FULLW", trip2Service["BFC1"]);
-  EXPECT_EQ("FULLW", trip2Service["BFC2"]);
-  EXPECT_EQ("WE", trip2Service["AAMV1"]);
+  ASSERT_EQ(11, trip2Service.size());
+  const IdMap& serviceIds = parser.data().lastServiceIds;
+  EXPECT_EQ("FULLW", serviceIds.id(service("AB1")));
+  EXPECT_EQ("FULLW", serviceIds.id(service("AB2")));
+  EXPECT_EQ("FULLW", serviceIds.id(service("STBA")));
+  EXPECT_EQ("FULLW", serviceIds.id(service("CITY1")));
+  EXPECT_EQ("FULLW", serviceIds.id(service("CITY2")));
+  EXPECT_EQ("FULLW", serviceIds.id(service("BFC1")));
+  EXPECT_EQ("FULLW", serviceIds.id(service("BFC2")));
+  EXPECT_EQ("WE", serviceIds.id(service("AAMV1")));
+  EXPECT_EQ(-1, parser.data().lastTripIds.find("TRIP1"));
 }
 
 // _____________________________________________________________________________
 TEST_F(GtfsParserTest, isActive) {
-  serviceActivity = parser.parseCalendarFile(tmpDir + "CalenderTest.TMP.txt");
+  calendar = parser.parseCalendarFile(tmpDir + "CalenderTest.TMP.txt");
   trip2Service = parser.parseTripsFile(tmpDir + "TripsTest.TMP.txt");
 
-  boost::gregorian::date date1 = from_iso_string("20120602T000000").date();
-  boost::gregorian::date date2 = from_iso_string("20120530T000000").date();
-  boost::gregorian::date date3 = from_iso_string("19900101T000000").date();
-  boost::gregorian::date date4 = from_iso_string("20200101T000000").date();
-  EXPECT_TRUE(parser.isActive(trip2Service["AB1"], serviceActivity, date1));
-  EXPECT_TRUE(parser.isActive(trip2Service["AAMV1"], serviceActivity, date1));
-  EXPECT_FALSE(parser.isActive(trip2Service["AAMV1"], serviceActivity, date2));
-  EXPECT_FALSE(parser.isActive(trip2Service["AAMV1"], serviceActivity, date3));
-  EXPECT_FALSE(parser.isActive(trip2Service["AAMV1"], serviceActivity, date4));
+  const int day1 = day("20120602");
+  const int day2 = day("20120530");
+  const int day3 = day("19900101");
+  const int day4 = day("20200101");
+  EXPECT_TRUE(parser.isActive(service("AB1"), calendar, day1));
+  EXPECT_TRUE(parser.isActive(service("AAMV1"), calendar, day1));
+  EXPECT_FALSE(parser.isActive(service("AAMV1"), calendar, day2));
+  EXPECT_FALSE(parser.isActive(service("AAMV1"), calendar, day3));
+  EXPECT_FALSE(parser.isActive(service("AAMV1"), calendar, day4));
+  EXPECT_FALSE(parser.isActive(-1, calendar, day1));
 }
 
 // _____________________________________________________________________________
@@ -190,22 +218,108 @@ TEST_F(GtfsParserTest, frequencies_txt) {
           "CITY1,19:00:00,22:00:00,1800\n"
           "CITY2,19:00:00,22:00:00,1800\n");
   fclose(file);
-  // TODO(jonas): enable this test when we support frequencies again
-  TEST_NOT_IMPLEMENTED
+  parser.parseTripsFile(tmpDir + "TripsTest.TMP.txt");
+  const IdMap& tripIds = parser.data().lastTripIds;
   frequencies = parser.parseFrequenciesFile(filename.c_str());
-  EXPECT_EQ(1800, frequencies["STBA"][0].frequency);
-  EXPECT_EQ(21600, frequencies["STBA"][0].start);
-  EXPECT_EQ(79200, frequencies["STBA"][0].finish);
-
-  EXPECT_EQ(600, frequencies["CITY1"][1].frequency);
-  EXPECT_EQ(28800, frequencies["CITY1"][1].start);
-  EXPECT_EQ(35999, frequencies["CITY1"][1].finish);
-
-  EXPECT_EQ(1800, frequencies["CITY2"][4].frequency);
-  EXPECT_EQ(68400, frequencies["CITY2"][4].start);
-  EXPECT_EQ(79200, frequencies["CITY2"][4].finish);
-  TEST_NOT_IMPLEMENTED
-  // TODO(jonas): Test generateStartTimes();
+  EXPECT_EQ(1800, frequencies[tripIds.find("STBA")][0].frequency);
+  EXPECT_EQ(21600, frequencies[tripIds.find("STBA")][0].start);
+  EXPECT_EQ(79200, frequencies[tripIds.find("STBA")][0].finish);
+
+  EXPECT_EQ(600, frequencies[tripIds.find("CITY1")][1].frequency);
+  EXPECT_EQ(28800, frequencies[tripIds.find("CITY1")][1].start);
+  EXPECT_EQ(35999, frequencies[tripIds.find("CITY1")][1].finish);
+
+  EXPECT_EQ(1800, frequencies[tripIds.find("CITY2")][4].frequency);
+  EXPECT_EQ(68400, frequencies[tripIds.find("CITY2")][4].start);
+  EXPECT_EQ(79200, frequencies[tripIds.find("CITY2")][4].finish);
+  EXPECT_EQ(32, frequencies[tripIds.find("STBA")][0].numRuns());
+  EXPECT_EQ(12, frequencies[tripIds.find("CITY1")][1].numRuns());
+  EXPECT_EQ(32, parser.numRuns(tripIds.find("STBA"), frequencies));
+  EXPECT_EQ(4 + 12 + 12 + 18 + 6,
+            parser.numRuns(tripIds.find("CITY1"), frequencies));
+  EXPECT_EQ(1, parser.numRuns(tripIds.find("AB1"), frequencies));
+}
+
+// _____________________________________________________________________________
+TEST_F(GtfsParserTest, frequencyLines) {
+  // A trip A -> B running every 10 minutes from 8:00 to 9:00 and a single trip
+  // B -> A.
+  const string dir = tmpDir + "frequency/";
+  mkdir(dir.c_str(), 0755);
+  std::ofstream file((dir + "calendar.txt").c_str());
+  file << "service_id,monday,tuesday,wednesday,thursday,friday,saturday,"
+       << "sunday,start_date,end_date\n"
+       << "WD,1,1,1,1,1,1,0,20110101,20121231\n";
+  file.close();
+  file.open((dir + "trips.txt").c_str());
+  file << "route_id,service_id,trip_id\nR1,WD,F\nR2,WD,S\n";
+  file.close();
+  file.open((dir + "stops.txt").c_str());
+  file << "stop_id,stop_name,stop_lat,stop_lon\nA,A,48.0,7.0\nB,B,48.1,7.0\n";
+  file.close();
+  file.open((dir + "stop_times.txt").c_str());
+  file << "trip_id,arrival_time,departure_time,stop_id,stop_sequence\n"
+       << "F,0:00:00,0:00:00,A,1\nF,0:10:00,0:10:00,B,2\n"
+       << "S,12:00:00,12:00:00,B,1\nS,12:10:00,12:10:00,A,2\n";
+  file.close();
+  file.open((dir + "frequencies.txt").c_str());
+  file << "trip_id,start_time,end_time,headway_secs\n"
+       << "F,8:00:00,9:00:00,600\n";
+  file.close();
+
+  vector<Line> lines;
+  TransitNetwork network = parser.createTransitNetwork(
+      dir, "20111216T000000", "20111216T235959", &lines);
+  // The network has the nodes of all runs, the line keeps the trip once.
+  EXPECT_EQ(6 * 6 + 6, network.numNodes());
+  ASSERT_EQ(2, lines.size());
+  GtfsParser firstRunParser;
+  firstRunParser.logger(&test_logger);
+  firstRunParser.expandFrequencies(false);
+  EXPECT_EQ(6 + 6, firstRunParser.createTransitNetwork(
+      dir, "20111216T000000", "20111216T235959").numNodes());
+  network.preprocess();
+
+  DirectConnection dc(network.numStops(), lines);
+  const int a = network.stopIndex("A");
+  const int b = network.stopIndex("B");
+  const int64_t time = str2time("20111216T080500");
+  EXPECT_EQ(time + 5 * 60, dc.nextDepartureTime(a, time, b));
+  EXPECT_EQ(15 * 60, dc.query(a, time, b));
+  EXPECT_EQ(4 * 60 * 60 + 5 * 60, dc.query(b, time, a));
+  EXPECT_EQ(DirectConnection::INFINITE, dc.query(a, time + 46 * 60, b));
+
+  // Dijkstra and transfer pattern queries after the first run take the next
+  // run, as the direct connections do.
+  TransferPatternRouter router(network);
+  router.logger(&test_logger);
+  router.prepare(lines);
+  HubSet hubs;
+  TPDB tpdb;
+  tpdb.init(network.numStops(), hubs);
+  for (size_t i = 0; i < network.numStops(); ++i) {
+    const set<vector<int> > patterns =
+        router.computeTransferPatterns(network, i, hubs);
+    for (auto it = patterns.begin(); it != patterns.end(); ++it)
+      tpdb.addPattern(*it);
+  }
+  router.transferPatternsDB(tpdb);
+  const int delays[] = {0, 30 * 60, 45 * 60};
+  for (int i = 0; i < 3; ++i) {
+    const int queryTime = time + delays[i];
+    const int dcCost = dc.query(a, queryTime, b);
+    Dijkstra dijkstra(network);
+    dijkstra.startTime(queryTime);
+    QueryResult result;
+    dijkstra.findShortestPath(
+        network.findStartNodeSequence(network.stop(a), queryTime), b, &result);
+    ASSERT_LT(0u, result.destLabels.size()) << queryTime;
+    EXPECT_EQ(dcCost, result.optimalCosts()) << queryTime;
+    vector<QueryResult::Path> paths = router.shortestPath(a, queryTime, b);
+    ASSERT_FALSE(paths.empty()) << queryTime;
+    EXPECT_EQ(dcCost, static_cast<int>(paths.begin()->first.cost()))
+        << queryTime;
+  }
 }
 
 // _____________________________________________________________________________
@@ -237,6 +351,50 @@ TEST_F(GtfsParserTest, stop_times_txt) {
   EXPECT_EQ(trips[1].id(), "TRIP2");
 }
 
+// _____________________________________________________________________________
+TEST_F(GtfsParserTest, stop_times_txt_chunks) {
+  TransitNetwork network;
+  const char* stops[] = {"A", "B", "C", "D", "E"};
+  for (int i = 0; i < 5; ++i) {
+    Stop stop(stops[i], stops[i], 0.f, 0.f);
+    network.addStop(stop);
+  }
+  string filename = tmpDir + "StopTimesChunksTest.TMP.txt";
+  std::ofstream file(filename.c_str());
+  file << "trip_id,arrival_time,departure_time,stop_id,stop_sequence\n";
+  for (int trip = 0; trip < 40; ++trip) {
+    // Trips of different length, some with an empty time and a repeated stop.
+    for (int i = 0; i < 2 + trip % 4; ++i) {
+      file << "TRIP" << trip << ",";
+      if (i == 1 && trip % 3 == 0)
+        file << ",";
+      else
+        file << trip << ":" << 10 + i << ":00," << trip << ":" << 10 + i
+             << ":00";
+      file << "," << stops[(trip + i) % 5] << "," << i << "\n";
+      if (i == 2 && trip % 5 == 0)
+        file << "TRIP" << trip << "," << trip << ":" << 10 + i << ":30,"
+             << trip << ":" << 10 + i << ":45," << stops[(trip + i) % 5]
+             << "," << i << "\n";
+    }
+  }
+  file.close();
+
+  vector<Trip> expected = parser.parseStopTimesFile(filename, network, 1);
+  ASSERT_EQ(40, expected.size());
+  EXPECT_EQ("TRIP39", expected.back().id());
+  for (int numChunks = 2; numChunks < 60; numChunks += 3) {
+    vector<Trip> trips = parser.parseStopTimesFile(filename, network,
+                                                   numChunks);
+    ASSERT_EQ(expected.size(), trips.size()) << numChunks;
+    for (size_t i = 0; i < trips.size(); ++i) {
+      EXPECT_EQ(expected[i].id(), trips[i].id());
+      EXPECT_EQ(expected[i].time(), trips[i].time());
+      EXPECT_EQ(expected[i].stops(), trips[i].stops());
+    }
+  }
+}
+
 // _____________________________________________________________________________
 /* A minimal transit network with two buses TRIP1 and TRIP2:
  *       E
@@ -328,6 +486,34 @@ TEST_F(GtfsParserTest, removeInterTripArcs) {
   EXPECT_EQ(16, network.numArcs());
 }
 
+// _____________________________________________________________________________
+TEST_F(GtfsParserTest, generateInterTripArcs) {
+  TransitNetwork network;
+  Stop stop("S", 0.f, 0.f);
+  network.addStop(stop);
+  network.addTransitNode(0, Node::DEPARTURE, 100);
+  network.addTransitNode(0, Node::TRANSFER, 100);
+  network.addTransitNode(0, Node::ARRIVAL, 100);
+  network.addTransitNode(0, Node::TRANSFER, 50);
+  network.addTransitNode(0, Node::DEPARTURE, 200);
+  network.addTransitNode(0, Node::TRANSFER, 100);
+  parser.generateInterTripArcs(&network);
+
+  // Sorted by time, transfer nodes before the other nodes of equal time.
+  EXPECT_THAT(network.stop(0).getNodeIndices(), ElementsAre(3, 1, 5, 0, 2, 4));
+  EXPECT_EQ(4, network.numArcs());
+  EXPECT_THAT(network.adjacencyList(3), ElementsAre(Arc(1, 50, 0)));
+  EXPECT_THAT(network.adjacencyList(1), ElementsAre(Arc(5, 0, 0)));
+  EXPECT_THAT(network.adjacencyList(5),
+              ElementsAre(Arc(0, 0, 0), Arc(4, 100, 0)));
+  // The sorted times are kept for the start node search.
+  EXPECT_TRUE(network.hasStopTimes());
+  EXPECT_THAT(network.findStartNodeSequence(network.stop(0), 100),
+              ElementsAre(1));
+  EXPECT_THAT(network.findStartNodeSequence(network.stop(0), 101),
+              ElementsAre(4));
+}
+
 // _____________________________________________________________________________
 TEST_F(GtfsParserTest, loadSaveNonexistingFile) {
   TransitNetwork network;
@@ -360,7 +546,10 @@ TEST_F(GtfsParserTest, serialization) {
   parser.load("local/serializedNetwork.TMP.bin", &loadedNetwork);
   const Stop* s2 = loadedNetwork.findNearestStop(0, 0);
 
-  ASSERT_THAT(loadedNetwork._nodes, ContainerEq(network._nodes));
+  ASSERT_THAT(loadedNetwork._nodeStops, ContainerEq(network._nodeStops));
+  ASSERT_THAT(loadedNetwork._nodeTimes, ContainerEq(network._nodeTimes));
+  ASSERT_THAT(loadedNetwork._nodeTypes, ContainerEq(network._nodeTypes));
+  ASSERT_EQ(network._timeEpoch, loadedNetwork._timeEpoch);
   // ASSERT_THAT(loadedNetwork.stops_, ContainerEq(network.stops_));
   ASSERT_THAT(loadedNetwork._adjacencyLists,
               ContainerEq(network._adjacencyLists));
@@ -575,3 +764,99 @@ TEST_F(GtfsParserTest, walkingGraphNonReflexive) {
   EXPECT_EQ(0, simple_network_two_days.walkwayList(3).size());
   EXPECT_EQ(0, simple_network_two_days.walkwayList(4).size());
 }
+
+// _____________________________________________________________________________
+TEST_F(GtfsParserTest, periodicNetwork) {
+  // A weekday and a sunday service and a trip over midnight, parsed for
+  // friday to sunday.
+  const string dir = tmpDir + "periodic/";
+  mkdir(dir.c_str(), 0755);
+  std::ofstream file((dir + "calendar.txt").c_str());
+  file << "service_id,monday,tuesday,wednesday,thursday,friday,saturday,"
+       << "sunday,start_date,end_date\n"
+       << "WD,1,1,1,1,1,1,0,20110101,20121231\n"
+       << "WE,0,0,0,0,0,0,1,20110101,20121231\n";
+  file.close();
+  file.open((dir + "trips.txt").c_str());
+  file << "route_id,service_id,trip_id\n"
+       << "R1,WD,T1\nR1,WE,T2\nR2,WD,T3\nR3,WD,T4\n";
+  file.close();
+  file.open((dir + "stops.txt").c_str());
+  file << "stop_id,stop_name,stop_lat,stop_lon\n"
+       << "A,A,48.0,7.0\nB,B,48.1,7.0\nC,C,48.2,7.0\nD,D,48.3,7.0\n";
+  file.close();
+  file.open((dir + "stop_times.txt").c_str());
+  file << "trip_id,arrival_time,departure_time,stop_id,stop_sequence\n"
+       << "T1,8:00:00,8:00:00,A,1\nT1,8:20:00,8:25:00,B,2\n"
+       << "T1,8:40:00,8:40:00,C,3\n"
+       << "T2,9:00:00,9:00:00,A,1\nT2,9:30:00,9:30:00,C,2\n"
+       << "T3,23:40:00,23:40:00,B,1\nT3,24:20:00,24:20:00,D,2\n"
+       << "T4,10:00:00,10:00:00,C,1\nT4,10:30:00,10:30:00,D,2\n";
+  file.close();
+
+  const string start = "20111216T000000";
+  const string end = "20111218T235959";
+  TransitNetwork network = parser.createTransitNetwork(dir, start, end);
+  GtfsParser periodicParser;
+  periodicParser.logger(&test_logger);
+  periodicParser.periodic(true);
+  TransitNetwork periodic = periodicParser.createTransitNetwork(dir, start,
+                                                                end);
+  EXPECT_EQ(0, network.period());
+  EXPECT_EQ(kSecondsPerDay, periodic.period());
+  EXPECT_LT(periodic.numNodes(), network.numNodes());
+  periodic.validate();
+
+  // Queries within one day find the same optimal paths in both networks, also
+  // from the day before the time period.
+  const int times[] = {0, 7 * 3600, 8 * 3600 + 10 * 60, 9 * 3600,
+                       23 * 3600 + 30 * 60, 23 * 3600 + 50 * 60};
+  for (int day = -1; day < 3; ++day) {
+    for (int i = 0; i < 6; ++i) {
+      const int time = str2time(start) + day * kSecondsPerDay + times[i];
+      for (int stop = 0; stop < 4; ++stop) {
+        for (int destStop = 0; destStop < 4; ++destStop) {
+          if (destStop == stop)
+            continue;
+          Dijkstra dijkstra(network);
+          Dijkstra periodicDijkstra(periodic);
+          dijkstra.logger(&test_logger);
+          periodicDijkstra.logger(&test_logger);
+          dijkstra.startTime(time);
+          periodicDijkstra.startTime(time);
+          dijkstra.maxCost(kSecondsPerDay - 1);
+          QueryResult result;
+          QueryResult periodicResult;
+          dijkstra.findShortestPath(
+              network.findStartNodeSequence(network.stop(stop), time),
+              destStop, &result);
+          periodicDijkstra.findShortestPath(
+              periodic.findStartNodeSequence(periodic.stop(stop), time),
+              destStop, &periodicResult);
+          std::set<std::pair<int, int> > costs;
+          std::set<std::pair<int, int> > periodicCosts;
+          for (auto it = result.destLabels.begin();
+               it != result.destLabels.end(); ++it)
+            costs.insert(std::make_pair((*it).cost(), (*it).penalty()));
+          for (auto it = periodicResult.destLabels.begin();
+               it != periodicResult.destLabels.end(); ++it)
+            periodicCosts.insert(std::make_pair((*it).cost(),
+                                                (*it).penalty()));
+          EXPECT_EQ(costs, periodicCosts)
+              << day << " " << times[i] << " " << stop << " " << destStop;
+        }
+      }
+    }
+  }
+
+  // Periodic networks span at most 64 days, longer time periods are clamped.
+  const TransitNetwork days64 = periodicParser.createTransitNetwork(
+      dir, start, "20120217T235959");
+  const TransitNetwork days70 = periodicParser.createTransitNetwork(
+      dir, start, "20120223T235959");
+  ASSERT_EQ(days64.numNodes(), days70.numNodes());
+  for (size_t node = 0; node < days64.numNodes(); ++node) {
+    for (int day = 0; day < 64; ++day)
+      ASSERT_EQ(days64.runs(node, day), days70.runs(node, day));
+  }
+}
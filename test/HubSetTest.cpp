@@ -0,0 +1,27 @@
+// Copyright 2012: Eugen Sawin, Philip Stahl, Jonas Sternisko
+#include <gmock/gmock.h>
+#include "../src/HubSet.h"
+
+using ::testing::ElementsAre;
+
+// _____________________________________________________________________________
+TEST(HubSetTest, insert) {
+  HubSet hubs;
+  EXPECT_TRUE(hubs.empty());
+  EXPECT_FALSE(hubs.contains(0));
+  EXPECT_TRUE(hubs.insert(130).second);
+  EXPECT_TRUE(hubs.insert(3).second);
+  EXPECT_FALSE(hubs.insert(130).second);
+  EXPECT_TRUE(hubs.insert(64).second);
+  EXPECT_EQ(3, hubs.size());
+  EXPECT_THAT(hubs, ElementsAre(3, 64, 130));
+  for (int stop = -1; stop < 200; ++stop) {
+    const bool hub = stop == 3 || stop == 64 || stop == 130;
+    EXPECT_EQ(hub, hubs.contains(stop)) << stop;
+    EXPECT_EQ(hub, hubs.find(stop) != hubs.end()) << stop;
+  }
+  EXPECT_TRUE(hubs == HubSet({130, 64, 3}));
+  hubs.clear();
+  EXPECT_FALSE(hubs.contains(3));
+  EXPECT_EQ(0, hubs.size());
+}
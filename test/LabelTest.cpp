@@ -133,6 +133,54 @@ TEST_F(LabelTest, LabelVec_add) {
   EXPECT_EQ(1, vec.size());
 }
 
+// _____________________________________________________________________________
+TEST_F(LabelTest, LabelVec_deactivate_pruneInactive) {
+  int at = 0;
+  int maxPenalty = 31;
+  LabelVec vec(at, maxPenalty);
+  vec.add(30, 1, maxPenalty, false, false, NULL);
+  vec.add(20, 5, maxPenalty, false, false, NULL);
+  vec.add(10, 30, maxPenalty, false, false, NULL);
+  // (30, 1), (20, 5), (10, 30)
+  EXPECT_EQ(3, vec.size());
+  EXPECT_FALSE(vec.candidate(10, 31));
+  EXPECT_TRUE(vec.candidate(9, 31));
+
+  vec.deactivate(20, 2);
+  // (30, 1), (20, 5)*, (10, 30)
+  EXPECT_FALSE(vec.field(1).inactive());
+  EXPECT_TRUE(vec.field(5).inactive());
+  EXPECT_FALSE(vec.field(30).inactive());
+  EXPECT_EQ(1, vec.pruneInactive());
+  // (30, 1), (10, 30)
+  EXPECT_EQ(2, vec.size());
+  EXPECT_TRUE(vec.contains(1));
+  EXPECT_FALSE(vec.contains(5));
+  EXPECT_TRUE(vec.contains(30));
+  EXPECT_EQ(10, vec.minCost());
+  EXPECT_EQ(1, vec.minPenalty());
+}
+
+// _____________________________________________________________________________
+TEST_F(LabelTest, LabelVec_const_iterator) {
+  int at = 0;
+  int maxPenalty = 31;
+  LabelVec vec(at, maxPenalty);
+  EXPECT_TRUE(vec.begin() == vec.end());
+  vec.add(30, 0, maxPenalty, false, false, NULL);
+  vec.add(20, 4, maxPenalty, false, false, NULL);
+  vec.add(10, 31, maxPenalty, false, false, NULL);
+  vector<int> penalties;
+  for (auto it = vec.begin(); it != vec.end(); ++it) {
+    EXPECT_EQ(at, it->at());
+    penalties.push_back(it->penalty());
+    // Drops the label at penalty 4 behind the current position.
+    if (it->penalty() == 0)
+      vec.add(15, 2, maxPenalty, false, false, NULL);
+  }
+  EXPECT_THAT(penalties, ElementsAre(0, 2, 31));
+}
+
 // _____________________________________________________________________________
 TEST_F(LabelTest, LabelVec_minCost_minPenalty) {
   int at = 0;
@@ -0,0 +1,75 @@
+// Copyright 2012: Eugen Sawin, Philip Stahl, Jonas Sternisko
+#include <gmock/gmock.h>
+#include <climits>
+#include <vector>
+#include "./GtestUtil.h"
+#include "../src/Landmarks.h"
+#include "../src/TransitNetwork.h"
+#include "../src/Utilities.h"
+
+using std::vector;
+
+class LandmarksTest : public ::testing::Test {
+ public:
+  // A time-compressed network: a path 0 -> 1 -> 2 -> 3 with a shortcut
+  // 0 -> 3, an arc 3 -> 4 back and a stop 5 only reaching 0.
+  void SetUp() {
+    for (int i = 0; i < 6; ++i) {
+      Stop stop(convert<string>(i), "", 0.f, 0.f);
+      network.addStop(stop);
+      const int node = network.addTransitNode(i, Node::NONE, 0);
+      network.stop(i).addNodeIndex(node);
+    }
+    network.addArc(0, 1, 10);
+    network.addArc(1, 2, 20);
+    network.addArc(2, 3, 30);
+    network.addArc(0, 3, 50);
+    network.addArc(3, 4, 5);
+    network.addArc(5, 0, 7);
+  }
+
+  TransitNetwork network;
+};
+
+TEST_F(LandmarksTest, init) {
+  Landmarks landmarks;
+  landmarks.init(network, 3, 0);
+  // Stop 5 is not reachable from stop 0, then 4 is the farthest.
+  ASSERT_EQ(3, landmarks.size());
+  EXPECT_EQ(5, landmarks.stops()[0]);
+  EXPECT_EQ(4, landmarks.stops()[1]);
+
+  landmarks.init(network, 10, 0);
+  EXPECT_EQ(6, landmarks.size());
+}
+
+TEST_F(LandmarksTest, lowerBound) {
+  const int costs[6][6] = {
+    {0, 10, 30, 50, 55, INT_MAX},
+    {INT_MAX, 0, 20, 50, 55, INT_MAX},
+    {INT_MAX, INT_MAX, 0, 30, 35, INT_MAX},
+    {INT_MAX, INT_MAX, INT_MAX, 0, 5, INT_MAX},
+    {INT_MAX, INT_MAX, INT_MAX, INT_MAX, 0, INT_MAX},
+    {7, 17, 37, 57, 62, 0}
+  };
+  for (int numLandmarks = 1; numLandmarks < 6; ++numLandmarks) {
+    Landmarks landmarks;
+    landmarks.init(network, numLandmarks, 0);
+    for (int s = 0; s < 6; ++s) {
+      for (int t = 0; t < 6; ++t) {
+        // Unreachable stops may have any bound, INFINITE only those.
+        EXPECT_LE(landmarks.lowerBound(s, t), costs[s][t]) << s << " " << t;
+      }
+    }
+  }
+  // With all stops as landmarks the bounds are exact.
+  Landmarks landmarks;
+  landmarks.init(network, 6, 0);
+  for (int s = 0; s < 6; ++s)
+    for (int t = 0; t < 6; ++t)
+      EXPECT_EQ(costs[s][t], landmarks.lowerBound(s, t)) << s << " " << t;
+  // The slack lowers the bounds.
+  landmarks.init(network, 6, 20);
+  EXPECT_EQ(35, landmarks.lowerBound(0, 4));
+  EXPECT_EQ(0, landmarks.lowerBound(0, 1));
+}
@@ -0,0 +1,103 @@
+// Copyright 2011: Eugen Sawin, Philip Stahl, Jonas Sternisko
+#include <gmock/gmock.h>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "./GtestUtil.h"
+#include "../src/Logger.h"
+
+using std::string;
+using std::vector;
+using std::ifstream;
+
+class LoggerTest : public ::testing::Test {
+ public:
+  void SetUp() {
+    filename = tmpDir + "LoggerTest.TMP.log";
+    remove(filename.c_str());
+  }
+
+  void TearDown() {
+    remove(filename.c_str());
+  }
+
+  // Returns the lines of the log file.
+  vector<string> readLines() const {
+    vector<string> lines;
+    ifstream ifs(filename.c_str());
+    string line;
+    while (getline(ifs, line)) {
+      lines.push_back(line);
+    }
+    return lines;
+  }
+
+  string filename;
+};
+
+// _____________________________________________________________________________
+TEST_F(LoggerTest, flush) {
+  Logger log;
+  log.target(filename);
+  log.info("first %d", 1);
+  log.error("second");
+  log.flush();
+  vector<string> lines = readLines();
+  ASSERT_EQ(2, lines.size());
+  EXPECT_EQ("[ info@", lines[0].substr(0, 7));
+  EXPECT_EQ("] first 1", lines[0].substr(lines[0].size() - 9));
+  EXPECT_EQ("[error@", lines[1].substr(0, 7));
+  EXPECT_EQ("] second", lines[1].substr(lines[1].size() - 8));
+}
+
+// _____________________________________________________________________________
+TEST_F(LoggerTest, flushAlways) {
+  Logger log;
+  log.target(filename);
+  log.flushPolicy(Logger::kFlushAlways);
+  log.info("synchronous");
+  EXPECT_EQ(1, readLines().size());
+}
+
+// _____________________________________________________________________________
+TEST_F(LoggerTest, copiesShareTarget) {
+  Logger log;
+  log.target(filename);
+  {
+    Logger copy = log;
+    copy.info("from copy");
+  }
+  log.info("from original");
+  log.flush();
+  vector<string> lines = readLines();
+  ASSERT_EQ(2, lines.size());
+  EXPECT_THAT(lines[0], ::testing::EndsWith("from copy"));
+  EXPECT_THAT(lines[1], ::testing::EndsWith("from original"));
+}
+
+// _____________________________________________________________________________
+TEST_F(LoggerTest, messageLength) {
+  Logger log;
+  log.target(filename);
+  log.info(string(2 * log.maxMessageLength(), 'x'));
+  log.flush();
+  vector<string> lines = readLines();
+  ASSERT_EQ(1, lines.size());
+  EXPECT_EQ(log.maxMessageLength() - 1,
+            lines[0].size() - lines[0].find("] ") - 2);
+}
+
+// _____________________________________________________________________________
+TEST_F(LoggerTest, concurrentLogging) {
+  Logger log;
+  log.target(filename);
+  const uint64_t droppedBefore = Logger::numDropped();
+  const int numMessages = 2000;
+  #pragma omp parallel for
+  for (int i = 0; i < numMessages; ++i) {
+    log.info("message %d", i);
+  }
+  log.flush();
+  const uint64_t numDropped = Logger::numDropped() - droppedBefore;
+  EXPECT_EQ(numMessages, readLines().size() + numDropped);
+}
@@ -75,7 +75,7 @@ TEST(QueryGraphTest, QueryGraph) {
   vector<int> transferPattern3 = {0, 1, 4, 25};
 
   TransferPatternsDB db;
-  set<int> hubs;
+  HubSet hubs;
   db.init(6, hubs);
   db.addPattern(transferPattern1);
   db.addPattern(transferPattern2);
@@ -107,7 +107,7 @@ TEST(QueryGraphTest, generatePatterns) {
   vector<int> p1 = {A, B, C, D, E};
   vector<int> p2 = {A, B, E};
   TransferPatternsDB db;
-  set<int> hubs;
+  HubSet hubs;
   db.init(5, hubs);
   db.addPattern(p0);
   db.addPattern(p1);
@@ -233,7 +233,7 @@ TEST(QueryGraphTest, mergeGraphs) {
   int A(0), B(1), C(2), D(3), E(4), F(5);
 
   TPDB db;
-  set<int> hubs;
+  HubSet hubs;
   db.init(6, hubs);
   // tpgs for first graph
   db.addPattern({A, B, C});
@@ -266,7 +266,7 @@ TEST(QueryGraphTest, findPattern_and_containsPattern) {
   int A(5), B(4), C(3), D(2), E(1)/*, F(0)*/;
 
   TPDB db;
-  set<int> hubs;
+  HubSet hubs;
   db.init(6, hubs);
   db.addPattern({A, B, C});
   db.addPattern({A, B, D, C});
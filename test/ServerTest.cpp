@@ -51,6 +51,29 @@ TEST(ServerTest, parseQueryTest2) {
                                                      convert<string>(lon))));
 }
 
+TEST(ServerTest, loadGtfsWithoutCopies) {
+  Server server(8081, "data", "web", "log/server.test.log");
+  const size_t numCopies = TransitNetwork::numCopies();
+  server.loadGtfs("test/data/simple-parser-test-case/", firstOfMay(),
+                  firstOfMay() + kSecondsPerDay);
+  EXPECT_LT(0, server.network().numNodes());
+  EXPECT_EQ(numCopies, TransitNetwork::numCopies());
+}
+
+TEST(ServerTest, loadGtfsPeriodic) {
+  Server server(8081, "data", "web", "log/server.test.log");
+  server.periodicDays(7);
+  server.loadGtfs("test/data/simple-parser-test-case/", firstOfMay(),
+                  firstOfMay() + kSecondsPerDay);
+  EXPECT_EQ(0, server.network().period());
+  EXPECT_EQ(kSecondsPerDay, server.queryNetwork().period());
+  EXPECT_EQ(server.network().numStops(), server.queryNetwork().numStops());
+  server.periodicDays(0);
+  server.loadGtfs("test/data/simple-parser-test-case/", firstOfMay(),
+                  firstOfMay() + kSecondsPerDay);
+  EXPECT_EQ(&server.network(), &server.queryNetwork());
+}
+
 TEST(ServerTest, hubAndTPDBSerialization) {
   string testset = "test/data/simple-parser-test-case/";
   Server s1(8081, "data", "web", "log/server.test.log");
@@ -246,7 +246,7 @@ TEST_F(TransferPatternsDBTest, addPatternCorrectness) {
   EXPECT_EQ(TPG::INVALID_NODE, tpgStopA.destNode(B));
   EXPECT_NE(TPG::INVALID_NODE, tpgStopA.destNode(C));
 
-  set<int> hubs;
+  HubSet hubs;
   TPDB db(3, hubs);
   db.addPattern({A, B, C});
   TPG dbGraphA = db.graph(A);
@@ -254,3 +254,36 @@ TEST_F(TransferPatternsDBTest, addPatternCorrectness) {
   EXPECT_EQ(TPG::INVALID_NODE, dbGraphA.destNode(B));
   EXPECT_NE(TPG::INVALID_NODE, dbGraphA.destNode(C));
 }
+
+// _____________________________________________________________________________
+TEST_F(TransferPatternsDBTest, patterns) {
+  int A(0), B(1), C(2), D(3);
+  const set<vector<int> > patterns = {{A, B}, {A, B, C}, {A, C}, {A, B, D, C},
+                                      {A, D, B, C}};
+  TPG tpg(A);
+  for (auto it = patterns.begin(); it != patterns.end(); ++it)
+    tpg.addPattern(*it);
+  tpg.addPattern({A, B, C});
+  // The departure node, the prefix nodes of A->B, A->B->D, A->D and A->D->B
+  // and the destination nodes of B and C.
+  EXPECT_EQ(7, tpg.numNodes());
+  EXPECT_EQ(patterns, tpg.patterns());
+}
+
+// _____________________________________________________________________________
+TEST_F(TransferPatternsDBTest, hubsPerDatabase) {
+  // Databases with different hubs record their own destination hubs.
+  const HubSet hubsB = {B};
+  const HubSet hubsE = {E};
+  TPDB dbB(5, hubsB);
+  TPDB dbE(5, hubsE);
+  dbB.addPattern(p1);
+  dbE.addPattern(p1);
+  dbB.addPattern(p4);
+  dbE.addPattern(p4);
+  EXPECT_THAT(dbB.graph(A).destHubs(), ElementsAre());
+  EXPECT_THAT(dbE.graph(A).destHubs(), ElementsAre(E));
+  dbB.addPattern(p5);
+  dbB.addPattern(vector<int>({A, B}));
+  EXPECT_THAT(dbB.graph(A).destHubs(), ElementsAre(B));
+}
@@ -1,11 +1,13 @@
 // Copyright 2011: Eugen Sawin, Philip Stahl, Jonas Sternisko
 // #include <kdtree++/kdtree.hpp>
+#include <sstream>
 #include <string>
 #include <utility>
 #include <vector>
 #include "../src/TransitNetwork.h"
 #include "./GtestUtil.h"
 #include "../src/GtfsParser.h"
+#include "../src/Random.h"
 #include "../src/Utilities.h"
 
 using ::testing::ElementsAre;
@@ -18,6 +20,28 @@ TEST(TransitNetworkTest, CopyConstructor) {
   TransitNetwork b = a;
 }
 
+// _____________________________________________________________________________
+TEST(TransitNetworkTest, MoveConstructor) {
+  GtfsParser parser;
+  const size_t numCopies = TransitNetwork::numCopies();
+  TransitNetwork a =
+      parser.createTransitNetwork("test/data/simple-parser-test-case/",
+                                  "20111128T000000", "20111128T235959");
+  a.preprocess();
+  const string debugString = a.debugString();
+  TransitNetwork b(std::move(a));
+  EXPECT_EQ(debugString, b.debugString());
+  EXPECT_EQ(0, a.numNodes());
+  EXPECT_EQ(0, a.numStops());
+  a = std::move(b);
+  EXPECT_EQ(debugString, a.debugString());
+  EXPECT_EQ(0, b.numNodes());
+  EXPECT_EQ(a.stop(0), *a.findNearestStop(a.stop(0).lat(), a.stop(0).lon()));
+  EXPECT_EQ(numCopies, TransitNetwork::numCopies());
+  b = a;
+  EXPECT_EQ(numCopies + 1, TransitNetwork::numCopies());
+}
+
 // _____________________________________________________________________________
 TEST(TransitNetworkTest, Equals) {
   Node a1 = Node(0, Node::ARRIVAL, 0);
@@ -65,8 +89,8 @@ TEST(TransitNetworkTest, findFirstNode) {
   EXPECT_EQ(5, result10);
 
   // examine some special cases: sequence of equal values
-  tn._nodes[4] = tn._nodes[5];
-  tn._nodes[6] = tn._nodes[5];
+  tn._nodeTimes[4] = tn._nodeTimes[5];
+  tn._nodeTimes[6] = tn._nodeTimes[5];
 
   size_t result11 = tn.findFirstNode(s, 69);
   EXPECT_EQ(4, result11);
@@ -76,6 +100,32 @@ TEST(TransitNetworkTest, findFirstNode) {
   EXPECT_EQ(7, result13);
 }
 
+// _____________________________________________________________________________
+TEST(TransitNetworkTest, findFirstNodeIndex) {
+  // Stops small enough for the direct search and larger ones searched in the
+  // Eytzinger layout, with runs of equal times.
+  TransitNetwork tn;
+  const int sizes[] = {0, 1, 5, 32, 33, 100, 1000};
+  for (int i = 0; i < 7; ++i) {
+    Stop stop("s" + convert<string>(i), 0, 0);
+    tn.addStop(stop);
+    for (int j = 0; j < sizes[i]; ++j)
+      tn.addTransitNode(i, Node::ARRIVAL, 10 * (j / 3));
+  }
+  tn.buildStopTimes();
+  ASSERT_TRUE(tn.hasStopTimes());
+  for (int i = 0; i < 7; ++i) {
+    const Stop& stop = tn.stop(i);
+    for (int time = -5; time <= 10 * sizes[i] / 3 + 10; ++time) {
+      int expected = 0;
+      while (expected < sizes[i] &&
+             tn.node(stop.nodeIndex(expected)).time() < time)
+        ++expected;
+      ASSERT_EQ(expected, tn.findFirstNode(stop, time)) << i << " " << time;
+    }
+  }
+}
+
 // _____________________________________________________________________________
 TEST(TransitNetworkTest, findStartNodeSeq) {
   GtfsParser parser;
@@ -104,6 +154,48 @@ TEST(TransitNetworkTest, findStartNodeSeq) {
   EXPECT_THAT(indices, ElementsAre(5));
 }
 
+// _____________________________________________________________________________
+TEST(TransitNetworkTest, renumberNodes) {
+  GtfsParser parser;
+  const TransitNetwork tn =
+      parser.createTransitNetwork("test/data/simple-parser-test-case/",
+                                  "20111128T000000", "20111129T235959");
+  TransitNetwork renumbered = tn;
+  const vector<int> oldIndex = renumbered.renumberNodes();
+  ASSERT_EQ(tn.numNodes(), oldIndex.size());
+  ASSERT_EQ(tn.numArcs(), renumbered.numArcs());
+  for (size_t i = 0; i < oldIndex.size(); ++i) {
+    const int old = oldIndex[i];
+    EXPECT_EQ(tn.node(old), renumbered.node(i));
+    const vector<Arc>& arcs = tn.adjacencyList(old);
+    const vector<Arc>& newArcs = renumbered.adjacencyList(i);
+    ASSERT_EQ(arcs.size(), newArcs.size());
+    for (size_t j = 0; j < arcs.size(); ++j) {
+      EXPECT_EQ(arcs[j].destination(), oldIndex[newArcs[j].destination()]);
+      EXPECT_EQ(arcs[j].cost(), newArcs[j].cost());
+      EXPECT_EQ(arcs[j].penalty(), newArcs[j].penalty());
+    }
+  }
+  // The nodes of each stop are numbered consecutively in time order.
+  for (size_t i = 0; i < tn.numStops(); ++i) {
+    const Stop& stop = renumbered.stop(i);
+    ASSERT_EQ(tn.stop(i).numNodes(), stop.numNodes());
+    for (int k = 0; k < stop.numNodes(); ++k) {
+      EXPECT_EQ(tn.stop(i).nodeIndex(k), oldIndex[stop.nodeIndex(k)]);
+      if (k > 0) {
+        EXPECT_EQ(stop.nodeIndex(k - 1) + 1, stop.nodeIndex(k));
+      }
+    }
+    const int time = str2time("20111128T001300");
+    const vector<int> startNodes = tn.findStartNodeSequence(tn.stop(i), time);
+    const vector<int> newStartNodes = renumbered.findStartNodeSequence(stop,
+                                                                       time);
+    ASSERT_EQ(startNodes.size(), newStartNodes.size());
+    for (size_t k = 0; k < startNodes.size(); ++k)
+      EXPECT_EQ(startNodes[k], oldIndex[newStartNodes[k]]);
+  }
+}
+
 // _____________________________________________________________________________
 TEST(TransitNetworkTest, KDTreeTest_nearest) {
   // Demonstrates the usage of libkdtree++ nearest neighbor search.
@@ -193,6 +285,107 @@ TEST(TransitNetworkTest, createTimeCompressedNetwork) {
   EXPECT_EQ(stopsUncompressed, nodesCompressed);
 }
 
+// _____________________________________________________________________________
+TEST(TransitNetworkTest, walkCost) {
+  TransitNetwork network;
+  Stop a("a", "a", 48.000, 7.800);
+  Stop b("b", "b", 48.0006, 7.800);
+  Stop c("c", "c", 48.0003, 7.800);
+  Stop far("far", "far", 49.000, 7.800);
+  network.addStop(a);
+  network.addStop(b);
+  network.addStop(c);
+  network.addStop(far);
+  for (size_t i = 0; i < network.numStops(); ++i)
+    network.addTransitNode(i, Node::TRANSFER, 0);
+  network.preprocess();
+  for (size_t i = 0; i < network.numStops(); ++i) {
+    for (size_t j = 0; j < network.numStops(); ++j) {
+      int cost = INT_MAX;
+      const vector<Arc>& arcs = network.walkwayList(i);
+      for (auto it = arcs.begin(); it != arcs.end(); ++it)
+        if (it->destination() == static_cast<int>(j))
+          cost = it->cost();
+      EXPECT_EQ(cost, network.walkCost(i, j));
+    }
+  }
+  EXPECT_NE(INT_MAX, network.walkCost(0, 1));
+  EXPECT_EQ(INT_MAX, network.walkCost(0, 0));
+  EXPECT_EQ(INT_MAX, network.walkCost(0, 3));
+}
+
+// _____________________________________________________________________________
+TEST(TransitNetworkTest, buildWalkingGraph) {
+  // Random stops in a small area and a few at high latitudes, compared with
+  // all pairs within the distance.
+  TransitNetwork network;
+  RandomFloatGen random(0.f, 1.f, 7);
+  vector<Stop> stops;
+  for (int i = 0; i < 300; ++i) {
+    const float lat = i < 280 ? 48.f + 0.01f * random.next()
+                              : 70.f + 0.002f * random.next();
+    const float lon = 7.8f + 0.01f * random.next();
+    stops.push_back(Stop(convert<string>(i), "", lat, lon));
+  }
+  for (size_t i = 0; i < stops.size(); ++i)
+    network.addStop(stops[i]);
+  const float dist = 150.f;
+  network.buildWalkingGraph(dist);
+  size_t numArcs = 0;
+  for (size_t i = 0; i < network.numStops(); ++i) {
+    vector<Arc> expected;
+    for (size_t j = 0; j < network.numStops(); ++j) {
+      const float d = greatCircleDistance(network.stopLat(i),
+                                          network.stopLon(i),
+                                          network.stopLat(j),
+                                          network.stopLon(j));
+      if (i != j && d <= dist)
+        expected.push_back(Arc(j, d / (5.f * 1000.f / 60.f / 60.f), 1));
+    }
+    EXPECT_EQ(expected, network.walkwayList(i));
+    numArcs += expected.size();
+  }
+  EXPECT_GT(numArcs, 0);
+}
+
+// _____________________________________________________________________________
+TEST(TransitNetworkTest, addWalkArcs) {
+  // Stop a reaches c only by walking over b.
+  TransitNetwork network;
+  Stop a("a", "a", 48.0000, 7.800);
+  Stop b("b", "b", 48.0007, 7.800);
+  Stop c("c", "c", 48.0014, 7.800);
+  network.addStop(a);
+  network.addStop(b);
+  network.addStop(c);
+  const int arrival = network.addTransitNode(0, Node::ARRIVAL, 1000);
+  network.addTransitNode(1, Node::TRANSFER, 2000);
+  network.addTransitNode(2, Node::DEPARTURE, 1100);
+  const int dep = network.addTransitNode(2, Node::DEPARTURE, 1300);
+  const int transfer = network.addTransitNode(2, Node::TRANSFER, 1350);
+  network.addTransitNode(2, Node::DEPARTURE, 1400);
+  network.preprocess();
+  const int costAB = network.walkCost(0, 1);
+  const int costBC = network.walkCost(1, 2);
+  ASSERT_NE(INT_MAX, costAB);
+  ASSERT_NE(INT_MAX, costBC);
+  EXPECT_EQ(INT_MAX, network.walkCost(0, 2));
+  EXPECT_EQ(vector<Arc>(1, Arc(1, costAB, 1)),
+            network.closedWalkways(0, costAB + costBC - 1));
+
+  const size_t numArcs = network.numArcs();
+  network.addWalkArcs(costAB + costBC);
+  EXPECT_EQ(costAB + costBC, network.maxWalkTime());
+  EXPECT_EQ(costAB + costBC, network.walkCost(0, 2));
+  EXPECT_EQ(costBC, network.walkCost(2, 1));
+  vector<Arc> expected;
+  expected.push_back(Arc(1, 1000, 1, true));
+  expected.push_back(Arc(dep, 300, 1, true));
+  expected.push_back(Arc(transfer, 350, 1, true));
+  EXPECT_EQ(expected, network.adjacencyList(arrival));
+  EXPECT_EQ(numArcs + 3, network.numArcs());
+}
+
 // _____________________________________________________________________________
 TEST(TransitNetworkTest, computeGeoInfo) {
   GtfsParser parser;
@@ -256,3 +449,78 @@ TEST(TransitNetworkTest, largestConnectedComponent) {
   EXPECT_EQ(compare.walkwayList(1), largestComponent.walkwayList(1));
   EXPECT_EQ(compare._walkwayLists, largestComponent._walkwayLists);
 }
+
+// _____________________________________________________________________________
+// The layout of TransitNetwork archives of version 0.
+struct NetworkV0 {
+  struct NodeV0 {
+    int stop;
+    int time;
+    Node::Type type;
+    template<class Archive>
+    void serialize(Archive& ar, const unsigned int version) {  // NOLINT
+      ar & stop;
+      ar & time;
+      ar & type;
+    }
+  };
+  vector<NodeV0> nodes;
+  vector<vector<Arc> > adjacencyLists;
+  size_t numArcs;
+  vector<Stop> stops;
+  vector<vector<Arc> > walkwayLists;
+  string name;
+  template<class Archive>
+  void serialize(Archive& ar, const unsigned int version) {  // NOLINT
+    ar & nodes;
+    ar & adjacencyLists;
+    ar & numArcs;
+    ar & stops;
+    ar & walkwayLists;
+    ar & name;
+  }
+};
+
+TEST(TransitNetworkTest, loadVersion0) {
+  NetworkV0 old;
+  old.nodes.push_back({0, 1325401200, Node::DEPARTURE});
+  old.nodes.push_back({1, 1325401800, Node::ARRIVAL});
+  old.adjacencyLists.resize(2);
+  old.adjacencyLists[0].push_back(Arc(1, 600, 0));
+  old.numArcs = 1;
+  old.stops.push_back(Stop("a", "a", 48.0, 7.8));
+  old.stops.push_back(Stop("b", "b", 48.1, 7.8));
+  old.walkwayLists.resize(2);
+  old.name = "old";
+  std::stringstream stream;
+  {
+    boost::archive::binary_oarchive oa(stream);
+    oa << old;
+  }
+  TransitNetwork network;
+  boost::archive::binary_iarchive ia(stream);
+  ia >> network;
+  ASSERT_EQ(2, network.numNodes());
+  EXPECT_EQ(Node(0, Node::DEPARTURE, 1325401200), network.node(0));
+  EXPECT_EQ(Node(1, Node::ARRIVAL, 1325401800), network.node(1));
+  EXPECT_EQ(1, network.numArcs());
+  EXPECT_EQ(Arc(1, 600, 0), network.adjacencyList(0)[0]);
+  ASSERT_EQ(2, network.numStops());
+  EXPECT_FLOAT_EQ(48.1f, network.stopLat(1));
+  EXPECT_FLOAT_EQ(7.8f, network.stopLon(1));
+  EXPECT_EQ("old", network.name());
+  EXPECT_EQ(0, network.maxWalkTime());
+
+  // It is saved in the current layout.
+  std::stringstream current;
+  {
+    boost::archive::binary_oarchive oa(current);
+    oa << network;
+  }
+  TransitNetwork loaded;
+  boost::archive::binary_iarchive ia2(current);
+  ia2 >> loaded;
+  EXPECT_EQ(network.debugString(), loaded.debugString());
+  EXPECT_EQ(network.node(1), loaded.node(1));
+  EXPECT_FLOAT_EQ(48.1f, loaded.stopLat(1));
+}